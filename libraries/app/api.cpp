@@ -258,6 +258,16 @@ namespace graphene { namespace app {
        return _app.p2p_node()->get_potential_peers();
     }
 
+    fork_database_stats network_node_api::get_fork_database_stats() const
+    {
+       return _app.chain_database()->get_fork_db_stats();
+    }
+
+    fork_switch_stats network_node_api::get_fork_switch_stats() const
+    {
+       return _app.chain_database()->get_fork_switch_stats();
+    }
+
     fc::variant_object network_node_api::get_advanced_node_parameters() const
     {
        return _app.p2p_node()->get_advanced_node_parameters();
@@ -458,6 +468,7 @@ namespace graphene { namespace app {
                  case impl_fund_history_object_type:
                  case impl_settings_object_type:
                  case impl_blind_transfer2_object_type:
+                 case impl_account_online_object_type:
                   break;
           }
        }
@@ -26,6 +26,7 @@
 #include <graphene/app/application.hpp>
 #include <graphene/app/plugin.hpp>
 #include <graphene/protocol/fee_schedule.hpp>
+#include <graphene/protocol/signature_cache.hpp>
 #include <graphene/protocol/types.hpp>
 #include <graphene/chain/worker_evaluator.hpp>
 #include <graphene/egenesis/egenesis.hpp>
@@ -299,6 +300,12 @@ namespace graphene { namespace app { namespace detail {
       }
       _chain_db->add_checkpoints( loaded_checkpoints );
 
+      // enabled before opening so that replayed blocks are fingerprinted as well
+      uint32_t fingerprint_interval = 0;
+      if( _options->count("state-fingerprint-interval") )
+         fingerprint_interval = _options->at("state-fingerprint-interval").as<uint32_t>();
+      enable_state_fingerprint( fingerprint_interval );
+
       if( _options->count("replay-blockchain") )
       {
          ilog("Replaying blockchain on user request.");
@@ -370,9 +377,22 @@ namespace graphene { namespace app { namespace detail {
          _chain_db.reset();
          _chain_db = std::make_shared<chain::database>();
          _chain_db->add_checkpoints(loaded_checkpoints);
+         enable_state_fingerprint( fingerprint_interval );
          _chain_db->open(_data_dir / "blockchain", initial_state);
       }
 
+      if( _options->count("import-blocks") )
+         import_blocks( _options->at("import-blocks").as<string>() );
+
+      if( _options->count("block-cache-size") )
+         _chain_db->set_block_cache_size( _options->at("block-cache-size").as<uint32_t>() );
+
+      if( _options->count("fork-db-max-size") )
+         _chain_db->set_fork_db_max_bytes( uint64_t(_options->at("fork-db-max-size").as<uint32_t>()) * 1024 * 1024 );
+
+      if( _options->count("signature-cache-size") )
+         signature_cache::instance().set_capacity( _options->at("signature-cache-size").as<uint32_t>() );
+
       if( _options->count("force-validate") )
       {
          ilog( "All transaction signatures will be validated" );
@@ -402,6 +422,55 @@ namespace graphene { namespace app { namespace detail {
       reset_websocket_tls_server();
    } FC_LOG_AND_RETHROW() }
 
+   void application_impl::import_blocks( const string& source )
+   { try {
+      uint32_t last_block_num = std::numeric_limits<uint32_t>::max();
+      if( _options->count("import-blocks-until") )
+         last_block_num = _options->at("import-blocks-until").as<uint32_t>();
+      else if( !_chain_db->get_checkpoints().empty() )
+         last_block_num = _chain_db->get_checkpoints().rbegin()->first;
+      else
+         FC_THROW( "Refusing to import blocks without a checkpoint or --import-blocks-until, "
+                   "their signatures are not checked" );
+
+      try
+      {
+         if( source == "-" )
+         {
+            ilog( "Importing blocks from standard input" );
+            _chain_db->import_blocks( std::cin, last_block_num );
+         }
+         else
+         {
+            ilog( "Importing blocks from ${s}", ("s",source) );
+            block_database blocks;
+            blocks.open( fc::path( source ) );
+            blocks.set_cache_size( 0 );
+            _chain_db->import_blocks( blocks, last_block_num );
+            blocks.close();
+         }
+      }
+      catch( const fc::exception& e )
+      {
+         // the state may be partially applied, keep the unclean shutdown marker so the next start replays
+         elog( "Importing blocks failed, the blockchain will be replayed on the next start" );
+         _replay_on_next_start = true;
+         throw;
+      }
+   } FC_CAPTURE_AND_RETHROW( (source) ) }
+
+   void application_impl::enable_state_fingerprint( uint32_t interval )
+   {
+      if( interval == 0 )
+         return;
+      _chain_db->enable_state_fingerprint();
+      _chain_db->applied_block.connect( [this,interval]( const signed_block& b ) {
+         if( b.block_num() % interval == 0 )
+            ilog( "State fingerprint at block #${n}: ${f}",
+                  ("n",b.block_num())("f",_chain_db->get_state_fingerprint().digest) );
+      });
+   }
+
    fc::optional< api_access_info > application_impl::get_api_access_info(const string& username)const
    {
       fc::optional< api_access_info > result;
@@ -443,7 +512,8 @@ namespace graphene { namespace app { namespace detail {
     * @throws exception if error validating the item, otherwise the item is safe to broadcast on.
     */
    bool application_impl::handle_block(const graphene::net::block_message& blk_msg, bool sync_mode,
-                             std::vector<fc::uint160_t>& contained_transaction_message_ids)
+                             std::vector<fc::uint160_t>& contained_transaction_message_ids,
+                             const std::string& origin)
    { try {
 
       auto latency = fc::time_point::now() - blk_msg.block.timestamp;
@@ -465,7 +535,12 @@ namespace graphene { namespace app { namespace detail {
          // you can help the network code out by throwing a block_older_than_undo_history exception.
          // when the net code sees that, it will stop trying to push blocks from that chain, but
          // leave that peer connected so that they can get sync blocks from us
-         bool result = _chain_db->push_block(blk_msg.block, (_is_block_producer | _force_validate) ? database::skip_nothing : database::skip_transaction_signatures);
+         uint32_t skip = (_is_block_producer | _force_validate) ? database::skip_nothing : database::skip_transaction_signatures;
+         // blocks covered by a checkpoint are only matched against the checkpoint ids, as during a replay
+         if( _chain_db->is_checkpointed( blk_msg.block.block_num() ) )
+            skip = database::skip_trusted_block_checks;
+         _chain_db->precompute_parallel( blk_msg.block );
+         bool result = _chain_db->push_block(blk_msg.block, skip, origin);
 
          // the block was accepted, so we now know all of the transactions contained in the block
          if (!sync_mode)
@@ -497,7 +572,7 @@ namespace graphene { namespace app { namespace detail {
          _is_finished_syncing = true;
          _self->syncing_finished();
       }
-   } FC_CAPTURE_AND_RETHROW( (blk_msg)(sync_mode) ) }
+   } FC_CAPTURE_AND_RETHROW( (blk_msg)(sync_mode)(origin) ) }
 
    void application_impl::handle_transaction(const graphene::net::trx_message& transaction_message)
    { try {
@@ -880,6 +955,16 @@ void application::set_program_options(boost::program_options::options_descriptio
          ("api-access", bpo::value<boost::filesystem::path>(), "JSON file specifying API permissions")
          ("io-threads", bpo::value<uint16_t>()->implicit_value(0), "Number of IO threads, default to 0 for auto-configuration")
          ("replay-blockchain", "Rebuild object graph by replaying all blocks")
+         ("snapshot-compaction-interval", bpo::value<uint32_t>(), "Number of incremental object database flushes between "
+                                                                 "two full rewrites, 0 to always rewrite the whole database")
+         ("state-fingerprint-interval", bpo::value<uint32_t>(), "Maintain a fingerprint of the chain state and log it "
+                                                               "every this many blocks, 0 to disable (default)")
+         ("block-cache-size", bpo::value<uint32_t>(), "Number of recently used blocks kept unpacked in memory, 0 to "
+                                                     "disable the cache (default 256)")
+         ("signature-cache-size", bpo::value<uint32_t>(), "Number of recovered signature keys kept in memory, 0 to "
+                                                         "disable the cache (default 50000)")
+         ("fork-db-max-size", bpo::value<uint32_t>(), "Size limit in MiB of the blocks in the fork database, blocks that "
+                                                     "are not on the current chain are evicted beyond it (default 128)")
          ;
    command_line_options.add(configuration_file_options);
    command_line_options.add_options()
@@ -888,6 +973,11 @@ void application::set_program_options(boost::program_options::options_descriptio
           "missing fields in a Genesis State will be added, and any unknown fields will be removed. If no file or an "
           "invalid file is found, it will be replaced with an example Genesis State.")
          ("resync-blockchain", "Delete all blocks and re-sync with network from scratch")
+         ("import-blocks", bpo::value<string>(), "Before connecting to the p2p network, apply the blocks of a trusted "
+                                                 "block database directory (block_num_to_block of another node), or "
+                                                 "of a block stream on stdin if \"-\", without checking signatures")
+         ("import-blocks-until", bpo::value<uint32_t>(), "Last block to import, defaults to the last checkpoint. "
+                                                        "Required by --import-blocks if there are no checkpoints")
          ("force-validate", "Force validation of all transactions")
          ("genesis-timestamp", bpo::value<uint32_t>(), "Replace timestamp from genesis.json with current time plus this many seconds (experts only!)")
          ;
@@ -903,6 +993,8 @@ void application::initialize(const fc::path& data_dir, const boost::program_opti
    if (options.count("fast")) {
        my->_chain_db->set_history_size(options.at("fast").as<int>());
    }
+   if( options.count("snapshot-compaction-interval") )
+      my->_chain_db->set_snapshot_compaction_interval( options.at("snapshot-compaction-interval").as<uint32_t>() );
    if( options.count("create-genesis-json") )
    {
       fc::path genesis_out = options.at("create-genesis-json").as<boost::filesystem::path>();
@@ -8,6 +8,8 @@ class application_impl : public net::node_delegate
       fc::optional<fc::temp_file> _lock_file;
       bool _is_block_producer = false;
       bool _force_validate = false;
+      /// keeps the unclean shutdown marker, e.g. after a failed import left a partially applied state
+      bool _replay_on_next_start = false;
 
       void reset_p2p_node(const fc::path& data_dir);
 
@@ -22,13 +24,18 @@ class application_impl : public net::node_delegate
            _chain_db(std::make_shared<chain::database>()) { }
 
       ~application_impl() {
-         fc::remove_all(_data_dir / "blockchain/dblock");
+         if( !_replay_on_next_start )
+            fc::remove_all(_data_dir / "blockchain/dblock");
       }
 
       void set_dbg_init_key( genesis_state_type& genesis, const std::string& init_key );
 
       void startup();
 
+      /** maintains the state fingerprint and logs it every interval blocks, see --state-fingerprint-interval */
+      void enable_state_fingerprint( uint32_t interval );
+      void import_blocks( const string& source );
+
       fc::optional< api_access_info > get_api_access_info(const string& username)const;
 
       void set_api_access_info(const string& username, api_access_info&& permissions);
@@ -47,7 +54,8 @@ class application_impl : public net::node_delegate
        * @throws exception if error validating the item, otherwise the item is safe to broadcast on.
        */
       virtual bool handle_block(const graphene::net::block_message& blk_msg, bool sync_mode,
-                                std::vector<fc::uint160_t>& contained_transaction_message_ids) override;
+                                std::vector<fc::uint160_t>& contained_transaction_message_ids,
+                                const std::string& origin) override;
 
       virtual void handle_transaction(const graphene::net::trx_message& transaction_message) override;
 
@@ -667,7 +667,7 @@ vector<vector<account_id_type>> database_api_impl::get_key_references( vector<pu
       subscribe_to_item(a5);
 
       const auto& idx = _db.get_index_type<account_index>();
-      const auto& aidx = dynamic_cast<const primary_index<account_index>&>(idx);
+      const auto& aidx = dynamic_cast<const base_primary_index&>(idx);
       const auto& refs = aidx.get_secondary_index<graphene::chain::account_member_index>();
       auto itr = refs.account_to_key_memberships.find(key);
       vector<account_id_type> result;
@@ -731,7 +731,7 @@ vector<vector<account_id_type>> database_api_impl::get_address_references(vector
    final_result.reserve(addresses.size());
 
    const auto& idx = _db.get_index_type<account_index>();
-   const auto& aidx = dynamic_cast<const primary_index<account_index>&>(idx);
+   const auto& aidx = dynamic_cast<const base_primary_index&>(idx);
    const auto& refs = aidx.get_secondary_index<graphene::chain::account_member_index>();
 
    for (auto& addr: addresses)
@@ -1019,7 +1019,7 @@ vector<account_id_type> database_api::get_account_references( account_id_type ac
 vector<account_id_type> database_api_impl::get_account_references( account_id_type account_id )const
 {
    const auto& idx = _db.get_index_type<account_index>();
-   const auto& aidx = dynamic_cast<const primary_index<account_index>&>(idx);
+   const auto& aidx = dynamic_cast<const base_primary_index&>(idx);
    const auto& refs = aidx.get_secondary_index<graphene::chain::account_member_index>();
    auto itr = refs.account_to_account_memberships.find(account_id);
    vector<account_id_type> result;
@@ -1559,7 +1559,10 @@ map<account_id_type, uint16_t> database_api::get_online_info()const
 
 map<account_id_type, uint16_t> database_api_impl::get_online_info()const
 {
-    return _db.get(accounts_online_id_type()).online_info;
+    map<account_id_type, uint16_t> result;
+    for( const auto& o : _db.get_index_type<account_online_index>().indices().get<by_account>() )
+       result.emplace_hint( result.end(), o.owner, o.minutes );
+    return result;
 }
 
 vector<force_settlement_object> database_api::get_settle_orders(asset_id_type a, uint32_t limit)const
@@ -292,6 +292,16 @@ namespace graphene { namespace app {
           */
          std::vector<net::potential_peer_record> get_potential_peers() const;
 
+         /**
+          * @brief Get the size of the fork database, per peer that sent the blocks
+          */
+         fork_database_stats get_fork_database_stats() const;
+
+         /**
+          * @brief Get the number, depth and duration of fork switches
+          */
+         fork_switch_stats get_fork_switch_stats() const;
+
       private:
          application& _app;
    };
@@ -442,6 +452,8 @@ FC_API(graphene::app::network_node_api,
        (get_potential_peers)
        (get_advanced_node_parameters)
        (set_advanced_node_parameters)
+       (get_fork_database_stats)
+       (get_fork_switch_stats)
      )
 FC_API(graphene::app::crypto_api,
        /*(blind_sign)
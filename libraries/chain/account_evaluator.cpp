@@ -60,7 +60,7 @@ void check_accounts_usage(database& _db, set<account_id_type> new_accs, set<publ
    {
       int count = 0;
       const auto& idx = _db.get_index_type<account_index>();
-      const auto& aidx = dynamic_cast<const primary_index<account_index>&>(idx);
+      const auto& aidx = dynamic_cast<const base_primary_index&>(idx);
       const auto& refs = aidx.get_secondary_index<graphene::chain::account_member_index>();
       auto itr = refs.account_to_key_memberships.find(key);
 
@@ -78,7 +78,7 @@ void check_accounts_usage(database& _db, set<account_id_type> new_accs, set<publ
    }
 
    const auto& idx = _db.get_index_type<account_index>();
-   const auto& aidx = dynamic_cast<const primary_index<account_index>&>(idx);
+   const auto& aidx = dynamic_cast<const base_primary_index&>(idx);
    const auto& refs = aidx.get_secondary_index<graphene::chain::account_member_index>();
 
    for( auto acc : new_accs)
@@ -722,9 +722,36 @@ void_result set_online_time_evaluator::do_apply(const set_online_time_operation&
 { try {
    database& d = db();
 
-   d.modify(d.get(accounts_online_id_type()), [&](accounts_online_object& obj) {
-      obj.online_info = o.online_info;
-   });
+   // the operation replaces the whole report, only the entries that differ are written
+   const auto& idx = d.get_index_type<account_online_index>().indices().get<by_account>();
+   auto new_itr = o.online_info.begin();
+   auto itr = idx.begin();
+   while (itr != idx.end() || new_itr != o.online_info.end())
+   {
+      if (new_itr == o.online_info.end() || (itr != idx.end() && itr->owner < new_itr->first))
+      {
+         d.remove(*itr++);
+      }
+      else if (itr == idx.end() || new_itr->first < itr->owner)
+      {
+         d.create<account_online_object>([&](account_online_object& obj) {
+            obj.owner = new_itr->first;
+            obj.minutes = new_itr->second;
+         });
+         ++new_itr;
+      }
+      else
+      {
+         if (itr->minutes != new_itr->second)
+         {
+            d.modify(*itr, [&](account_online_object& obj) {
+               obj.minutes = new_itr->second;
+            });
+         }
+         ++itr;
+         ++new_itr;
+      }
+   }
 
    return void_result();
 } FC_CAPTURE_AND_RETHROW( (o) ) }
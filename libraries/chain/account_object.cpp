@@ -51,15 +51,19 @@ void account_balance_object::adjust_balance(const asset& delta)
    balance += delta.amount;
 }
 
-void account_mature_balance_object::adjust_balance(const asset& delta, const asset& real_balance, int64_t mandatory)
+void account_mature_balance_object::adjust_balance(const asset& delta, const asset& real_balance, int64_t mandatory,
+                                                   undo_recorder<account_mature_balance_object>& undo)
 {
    assert(delta.asset_id == asset_type);
+   undo.save(&account_mature_balance_object::balance);
    int64_t value = delta.amount.value;
    if (value < 0) {
       if (value <= -mandatory) {
+          undo.save(&account_mature_balance_object::mandatory_transfer);
           mandatory_transfer = true;
       } 
       while (value < 0) {
+         const size_t last = history.size() - 1;
          auto& back = history.back();
          int64_t coins_to_remove = 0;
          if ( value + back.real_balance > 0) {
@@ -68,18 +72,24 @@ void account_mature_balance_object::adjust_balance(const asset& delta, const ass
             if (part_to_take > 1) part_to_take = 1;
             coins_to_remove += back.balance.value * part_to_take;
             value += back.real_balance.value * part_to_take;
+            undo.save_element(&account_mature_balance_object::history, last);
             back.real_balance -= back.real_balance * part_to_take;
             back.balance -= back.balance * part_to_take;
-            if (back.real_balance == 0) history.erase(--history.end());
+            if (back.real_balance == 0) {
+               undo.save_erase(&account_mature_balance_object::history, last);
+               history.erase(--history.end());
+            }
          } else {
             coins_to_remove += back.balance.value;
             value += back.real_balance.value;
+            undo.save_erase(&account_mature_balance_object::history, last);
             history.erase(--history.end());
          }
          balance -= coins_to_remove;
       }
    } else {
       balance += delta.amount;
+      undo.save_insert(&account_mature_balance_object::history, history.size());
       history.push_back(mature_balances_history(real_balance.amount, delta.amount));
    }
 }
@@ -130,7 +140,8 @@ asset bonus_balances_object::get_full_balance(asset_id_type asset_id, time_point
     return get_daily_balance(asset_id, time_point) + get_referral_balance(asset_id, time_point);
 }
 
-void bonus_balances_object::adjust_balance(const asset& delta, time_point_sec time_point, database* db)
+void bonus_balances_object::adjust_balance(const asset& delta, time_point_sec time_point, database* db,
+                                           undo_recorder<bonus_balances_object>& undo)
 {
     const int pos = (time_point != time_point_sec()) ? get_pos_by_date(time_point)  : 0;
 
@@ -139,6 +150,7 @@ void bonus_balances_object::adjust_balance(const asset& delta, time_point_sec ti
        if ( (db->head_block_time() <= HARDFORK_622_TIME)
              || ((db->head_block_time() > HARDFORK_622_TIME) && (delta.asset_id != EDC_ASSET)) )
        {
+          undo.save_insert(&bonus_balances_object::balances_by_date, 0);
           balances_by_date.insert(balances_by_date.begin(), bonus_balances_info(time_point));
           balances_by_date[0].balances.emplace(delta.asset_id, delta.amount);
        }
@@ -147,22 +159,26 @@ void bonus_balances_object::adjust_balance(const asset& delta, time_point_sec ti
     if (pos < 0) return;
 
     // increase balance in cases when maintenance_time interval is more often then 1 per 24 hours
+    undo.save_element(&bonus_balances_object::balances_by_date, pos);
     balances_by_date[pos].balances[delta.asset_id] += delta.amount;
 }
 
-void  bonus_balances_object::add_referral(referral_balance_info rbi, time_point_sec time_point, database* db)
+void  bonus_balances_object::add_referral(referral_balance_info rbi, time_point_sec time_point, database* db,
+                                          undo_recorder<bonus_balances_object>& undo)
 {
     const int pos = (time_point != time_point_sec()) ? get_pos_by_date(time_point) : 0;
 
     if ( (!balances_by_date.size() || pos == -1)
           && (db->head_block_time() < HARDFORK_622_TIME) ) // (referral system is already disabled)
     {
+        undo.save_insert(&bonus_balances_object::balances_by_date, 0);
         balances_by_date.insert(balances_by_date.begin(), bonus_balances_info(time_point));
         balances_by_date[0].referral = rbi;
         return;
     }
     if (pos < 0) return;
 
+    undo.save_element(&bonus_balances_object::balances_by_date, pos);
     balances_by_date[pos].referral = rbi;
 }
 
@@ -199,23 +215,29 @@ vector<bonus_balances_object::bonus_balances_info> bonus_balances_object::balanc
     return result;
 }
 
-void bonus_balances_object::remove(time_point_sec time) 
+void bonus_balances_object::remove(time_point_sec time, undo_recorder<bonus_balances_object>& undo)
 {
     if (!balances_by_date.size()) return;
 
     if (time == time_point_sec()) return;
     string date_string = get_date(time);
     string zero_time = "T00:00:00";
-    
-    balances_by_date.erase(std::remove_if(balances_by_date.begin(), balances_by_date.end(), [&] (bonus_balances_object::bonus_balances_info balance) {
-        return (time_point::from_iso_string(get_date(balance.bonus_time) + zero_time)
-                    <=
-                time_point::from_iso_string(date_string + zero_time));
-    }), balances_by_date.end());
+    const auto limit = time_point::from_iso_string(date_string + zero_time);
+
+    // back to front, so that an erasure does not move the elements still to be checked
+    for (size_t i = balances_by_date.size(); i-- > 0; )
+    {
+        if (time_point::from_iso_string(get_date(balances_by_date[i].bonus_time) + zero_time) <= limit)
+        {
+            undo.save_erase(&bonus_balances_object::balances_by_date, i);
+            balances_by_date.erase(balances_by_date.begin() + i);
+        }
+    }
 }
 
-void account_mature_balance_object::consider_mining(uint16_t minied_minutes) {
+void account_mature_balance_object::consider_mining(uint16_t minied_minutes, undo_recorder<account_mature_balance_object>& undo) {
     double minutes_in_day = 1440;
+    undo.save(&account_mature_balance_object::balance);
     balance = balance.value * (minied_minutes / minutes_in_day);
 }
 
@@ -438,10 +460,46 @@ void account_member_index::object_modified(const object& after)
 
 }
 
-void account_referrer_index::object_inserted( const object& obj ) { }
-void account_referrer_index::object_removed( const object& obj ) { }
-void account_referrer_index::about_to_modify( const object& before ) { }
-void account_referrer_index::object_modified( const object& after  ) { }
+void account_referrer_index::object_inserted( const object& obj )
+{
+   assert( dynamic_cast<const account_object*>(&obj) ); // for debug only
+   const account_object& a = static_cast<const account_object&>(obj);
+   referred_by[a.referrer].insert( a.id );
+}
+
+void account_referrer_index::object_removed( const object& obj )
+{
+   assert( dynamic_cast<const account_object*>(&obj) ); // for debug only
+   const account_object& a = static_cast<const account_object&>(obj);
+   auto itr = referred_by.find( a.referrer );
+   if( itr == referred_by.end() )
+      return;
+   itr->second.erase( a.id );
+   if( itr->second.empty() )
+      referred_by.erase( itr );
+}
+
+void account_referrer_index::about_to_modify( const object& before )
+{
+   assert( dynamic_cast<const account_object*>(&before) ); // for debug only
+   before_referrer = static_cast<const account_object&>(before).referrer;
+}
+
+void account_referrer_index::object_modified( const object& after  )
+{
+   assert( dynamic_cast<const account_object*>(&after) ); // for debug only
+   const account_object& a = static_cast<const account_object&>(after);
+   if( a.referrer == before_referrer )
+      return;
+   auto itr = referred_by.find( before_referrer );
+   if( itr != referred_by.end() )
+   {
+      itr->second.erase( a.id );
+      if( itr->second.empty() )
+         referred_by.erase( itr );
+   }
+   referred_by[a.referrer].insert( a.id );
+}
 
 } } // graphene::chain
 
@@ -485,6 +543,10 @@ FC_REFLECT_DERIVED_NO_TYPENAME( graphene::chain::accounts_online_object,
                                 (graphene::db::object),
                                 (online_info)
                               )
+FC_REFLECT_DERIVED_NO_TYPENAME( graphene::chain::account_online_object,
+                                (graphene::db::object),
+                                (owner)(minutes)
+                              )
 FC_REFLECT_DERIVED_NO_TYPENAME( graphene::chain::market_address_object,
                                 (graphene::db::object),
                                 (market_account_id)
@@ -508,6 +570,7 @@ FC_REFLECT_DERIVED_NO_TYPENAME( graphene::chain::account_mature_balance_object,
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::chain::account_object )
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::chain::restricted_account_object )
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::chain::accounts_online_object )
+GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::chain::account_online_object )
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::chain::market_address_object )
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::chain::blind_transfer2_object )
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::chain::bonus_balances_object )
@@ -24,53 +24,125 @@
 #include <graphene/chain/block_database.hpp>
 #include <graphene/protocol/fee_schedule.hpp>
 #include <fc/io/raw.hpp>
+#include <fc/compress/zlib.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace graphene { namespace chain {
 
-struct index_entry
+struct block_database::index_entry
 {
+   /**
+    * The position of a plain block in the blocks file. For a compressed block the highest bit is set, the next
+    * 23 bits hold the offset of the block in the decompressed chunk and the low 40 bits the position of the chunk.
+    */
    uint64_t      block_pos = 0;
    uint32_t      block_size = 0;
    block_id_type block_id;
 };
- }}
-FC_REFLECT( graphene::chain::index_entry, (block_pos)(block_size)(block_id) );
 
-namespace graphene { namespace chain {
+namespace {
+   const uint64_t compressed_flag    = uint64_t(1) << 63;
+   const uint32_t chunk_pos_bits     = 40;
+   const uint64_t chunk_pos_mask     = ( uint64_t(1) << chunk_pos_bits ) - 1;
+   const size_t   max_cached_chunks  = 4;
 
-void block_database::open( const fc::path& dbdir )
-{ try {
-   fc::create_directories(dbdir);
-   _block_num_to_pos.exceptions(std::ios_base::failbit | std::ios_base::badbit);
-   _blocks.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+   int open_file( const fc::path& p, bool truncate )
+   {
+      int fd = ::open( p.generic_string().c_str(), O_RDWR | O_CREAT | ( truncate ? O_TRUNC : 0 ), 0644 );
+      FC_ASSERT( fd >= 0, "Unable to open ${p}: ${e}", ("p",p)("e",strerror(errno)) );
+      return fd;
+   }
 
-   if( !fc::exists( dbdir/"index" ) )
+   uint64_t file_size( int fd )
    {
-     _block_num_to_pos.open( (dbdir/"index").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
+      off_t size = ::lseek( fd, 0, SEEK_END );
+      FC_ASSERT( size >= 0, "Unable to determine file size: ${e}", ("e",strerror(errno)) );
+      return uint64_t(size);
    }
-   else
+
+   /// reads exactly size bytes at pos, retrying short reads
+   bool read_at( int fd, char* data, size_t size, uint64_t pos )
    {
-     _block_num_to_pos.open( (dbdir/"index").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+      while( size > 0 )
+      {
+         ssize_t r = ::pread( fd, data, size, off_t(pos) );
+         if( r < 0 && errno == EINTR )
+            continue;
+         if( r <= 0 )
+            return false;
+         data += r;
+         size -= size_t(r);
+         pos += uint64_t(r);
+      }
+      return true;
+   }
+
+   void write_at( int fd, const char* data, size_t size, uint64_t pos )
+   {
+      while( size > 0 )
+      {
+         ssize_t r = ::pwrite( fd, data, size, off_t(pos) );
+         if( r < 0 && errno == EINTR )
+            continue;
+         FC_ASSERT( r > 0, "Unable to write to block database: ${e}", ("e",strerror(errno)) );
+         data += r;
+         size -= size_t(r);
+         pos += uint64_t(r);
+      }
    }
+}
+
+const size_t block_database::default_cache_size;
+const size_t block_database::max_chunk_size;
+
+block_database::~block_database()
+{
+   close();
+}
+
+void block_database::open( const fc::path& dbdir )
+{ try {
+   std::unique_lock<std::shared_timed_mutex> lock( _file_mutex );
+   fc::create_directories(dbdir);
+
+   const bool create = !fc::exists( dbdir/"index" );
+   _block_num_to_pos = open_file( dbdir/"index", create );
+   _blocks = open_file( dbdir/"blocks", create );
+   _index_size = file_size( _block_num_to_pos );
+   _blocks_size = file_size( _blocks );
 } FC_CAPTURE_AND_RETHROW( (dbdir) ) }
 
 bool block_database::is_open()const
 {
-  return _blocks.is_open();
+  return _blocks >= 0;
 }
 
 void block_database::close()
 {
-  _blocks.close();
-  _block_num_to_pos.close();
+  std::unique_lock<std::shared_timed_mutex> lock( _file_mutex );
+  if( _blocks >= 0 )
+     ::close( _blocks );
+  if( _block_num_to_pos >= 0 )
+     ::close( _block_num_to_pos );
+  _blocks = _block_num_to_pos = -1;
+  _blocks_size = _index_size = 0;
+
+  std::lock_guard<std::mutex> cache_lock( _cache_mutex );
+  _cache.clear();
+  _cache_lru.clear();
+  std::lock_guard<std::mutex> chunk_lock( _chunk_mutex );
+  _chunks.clear();
 }
 
 void block_database::flush()
 {
-  _blocks.flush();
-  _block_num_to_pos.flush();
+  std::shared_lock<std::shared_timed_mutex> lock( _file_mutex );
+  if( _blocks >= 0 )
+     ::fdatasync( _blocks );
+  if( _block_num_to_pos >= 0 )
+     ::fdatasync( _block_num_to_pos );
 }
 
 void block_database::store( const block_id_type& _id, const signed_block& b )
@@ -81,48 +153,174 @@ void block_database::store( const block_id_type& _id, const signed_block& b )
       id = b.id();
       elog( "id argument of block_database::store() was not initialized for block ${id}", ("id", id) );
    }
-   _block_num_to_pos.seekp( sizeof( index_entry ) * int64_t(block_header::num_from_id(id)) );
-   index_entry e;
-   _blocks.seekp( 0, _blocks.end );
    auto vec = fc::raw::pack( b );
-   e.block_pos  = _blocks.tellp();
+   const uint64_t index_pos = sizeof( index_entry ) * uint64_t(block_header::num_from_id(id));
+
+   std::unique_lock<std::shared_timed_mutex> lock( _file_mutex );
+   index_entry e;
+   if( read_entry( block_header::num_from_id(id), e ) )
+      cache_erase( e.block_id ); // replaced by a block of another fork
+
+   e.block_pos  = _blocks_size;
    e.block_size = vec.size();
    e.block_id   = id;
-   _blocks.write( vec.data(), vec.size() );
-   _block_num_to_pos.write( (char*)&e, sizeof(e) );
+   write_at( _blocks, vec.data(), vec.size(), e.block_pos );
+   _blocks_size += vec.size();
+   write_at( _block_num_to_pos, (const char*)&e, sizeof(e), index_pos );
+   _index_size = std::max( _index_size, index_pos + sizeof(e) );
+
+   cache_insert( id, std::make_shared<const signed_block>( b ) );
 }
 
+void block_database::store_compressed( const vector< std::pair<block_id_type, vector<char>> >& blocks )
+{ try {
+   if( blocks.empty() )
+      return;
+
+   // chunk layout: uint32_t compressed size, followed by the zlib stream of the concatenated blocks
+   std::string chunk;
+   vector<index_entry> entries;
+   entries.reserve( blocks.size() );
+   for( const auto& block : blocks )
+   {
+      FC_ASSERT( block.first != block_id_type() && !block.second.empty() );
+      index_entry e;
+      e.block_pos  = chunk.size();
+      e.block_size = block.second.size();
+      e.block_id   = block.first;
+      entries.push_back( e );
+      chunk.append( block.second.data(), block.second.size() );
+   }
+   FC_ASSERT( chunk.size() <= max_chunk_size, "Chunk of ${n} blocks is too large", ("n",blocks.size()) );
+   const std::string compressed = fc::zlib_compress( chunk );
+   const uint32_t compressed_size = compressed.size();
+
+   std::unique_lock<std::shared_timed_mutex> lock( _file_mutex );
+   const uint64_t chunk_pos = _blocks_size;
+   FC_ASSERT( chunk_pos <= chunk_pos_mask, "Block database too large for compressed chunks" );
+   write_at( _blocks, (const char*)&compressed_size, sizeof(compressed_size), chunk_pos );
+   write_at( _blocks, compressed.data(), compressed.size(), chunk_pos + sizeof(compressed_size) );
+   _blocks_size += sizeof(compressed_size) + compressed.size();
+
+   for( auto& e : entries )
+   {
+      const uint32_t block_num = block_header::num_from_id( e.block_id );
+      index_entry old;
+      if( read_entry( block_num, old ) )
+         cache_erase( old.block_id );
+
+      e.block_pos = compressed_flag | ( e.block_pos << chunk_pos_bits ) | chunk_pos;
+      const uint64_t index_pos = sizeof( index_entry ) * uint64_t(block_num);
+      write_at( _block_num_to_pos, (const char*)&e, sizeof(e), index_pos );
+      _index_size = std::max( _index_size, index_pos + sizeof(e) );
+   }
+} FC_CAPTURE_AND_RETHROW( (blocks.size()) ) }
+
 void block_database::remove( const block_id_type& id )
 { try {
+   std::unique_lock<std::shared_timed_mutex> lock( _file_mutex );
+   cache_erase( id );
+
    index_entry e;
-   auto index_pos = sizeof(e)*block_header::num_from_id(id);
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( (uint32_t)_block_num_to_pos.tellg() <= index_pos )
+   auto index_pos = sizeof(e)*uint64_t(block_header::num_from_id(id));
+   if ( _index_size <= index_pos )
       FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block ${id} not contained in block database", ("id", id));
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
+   FC_ASSERT( read_at( _block_num_to_pos, (char*)&e, sizeof(e), index_pos ) );
 
    if( e.block_id == id )
    {
       e.block_size = 0;
-      _block_num_to_pos.seekp( sizeof(e)*block_header::num_from_id(id) );
-      _block_num_to_pos.write( (char*)&e, sizeof(e) );
+      write_at( _block_num_to_pos, (const char*)&e, sizeof(e), index_pos );
    }
 } FC_CAPTURE_AND_RETHROW( (id) ) }
 
+bool block_database::read_entry( uint32_t block_num, index_entry& e )const
+{
+   auto index_pos = sizeof(e)*uint64_t(block_num);
+   if ( _index_size <= index_pos )
+      return false;
+   return read_at( _block_num_to_pos, (char*)&e, sizeof(e), index_pos );
+}
+
+bool block_database::read_last_entry( index_entry& e )const
+{
+   uint64_t pos = _index_size - _index_size % sizeof(index_entry);
+   while( pos > 0 )
+   {
+      pos -= sizeof(index_entry);
+      if( !read_at( _block_num_to_pos, (char*)&e, sizeof(e), pos ) )
+         return false;
+      if( e.block_size != 0 )
+         return true;
+   }
+   return false;
+}
+
+vector<char> block_database::read_block( const index_entry& e )const
+{
+   if( e.block_pos & compressed_flag )
+   {
+      const auto chunk = read_chunk( e.block_pos & chunk_pos_mask );
+      const uint64_t offset = ( e.block_pos & ~compressed_flag ) >> chunk_pos_bits;
+      FC_ASSERT( offset + e.block_size <= chunk->size(), "Block ${id} exceeds its chunk", ("id",e.block_id) );
+      return vector<char>( chunk->data() + offset, chunk->data() + offset + e.block_size );
+   }
+
+   vector<char> data( e.block_size );
+   FC_ASSERT( read_at( _blocks, data.data(), data.size(), e.block_pos ),
+              "Unable to read block ${id}", ("id",e.block_id) );
+   return data;
+}
+
+std::shared_ptr<const std::string> block_database::read_chunk( uint64_t chunk_pos )const
+{
+   {
+      std::lock_guard<std::mutex> lock( _chunk_mutex );
+      for( auto itr = _chunks.begin(); itr != _chunks.end(); ++itr )
+         if( itr->first == chunk_pos )
+         {
+            _chunks.splice( _chunks.begin(), _chunks, itr );
+            return itr->second;
+         }
+   }
+
+   uint32_t compressed_size = 0;
+   FC_ASSERT( read_at( _blocks, (char*)&compressed_size, sizeof(compressed_size), chunk_pos ),
+              "Unable to read chunk at ${p}", ("p",chunk_pos) );
+   std::string compressed( compressed_size, '\0' );
+   FC_ASSERT( read_at( _blocks, &compressed[0], compressed.size(), chunk_pos + sizeof(compressed_size) ),
+              "Unable to read chunk at ${p}", ("p",chunk_pos) );
+   auto chunk = std::make_shared<const std::string>( fc::zlib_decompress( compressed ) );
+
+   std::lock_guard<std::mutex> lock( _chunk_mutex );
+   _chunks.emplace_front( chunk_pos, chunk );
+   if( _chunks.size() > max_cached_chunks )
+      _chunks.pop_back();
+   return chunk;
+}
+
+optional<signed_block> block_database::fetch_entry( const index_entry& e )const
+{
+   if( auto cached = cache_find( e.block_id ) )
+      return *cached;
+
+   // the caller holds _file_mutex, so a concurrent remove() cannot leave this block in the cache
+   auto result = std::make_shared<signed_block>( fc::raw::unpack<signed_block>( read_block( e ) ) );
+   FC_ASSERT( result->id() == e.block_id );
+   cache_insert( e.block_id, result );
+   return *result;
+}
+
 bool block_database::contains( const block_id_type& id )const
 {
    if( id == block_id_type() )
       return false;
 
+   std::shared_lock<std::shared_timed_mutex> lock( _file_mutex );
    index_entry e;
-   auto index_pos = sizeof(e)*block_header::num_from_id(id);
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( (size_t)_block_num_to_pos.tellg() <= index_pos )
+   if( !read_entry( block_header::num_from_id(id), e ) )
       return false;
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
 
    return e.block_id == id && e.block_size > 0;
 }
@@ -130,15 +328,11 @@ bool block_database::contains( const block_id_type& id )const
 block_id_type block_database::fetch_block_id( uint32_t block_num )const
 {
    assert( block_num != 0 );
+   std::shared_lock<std::shared_timed_mutex> lock( _file_mutex );
    index_entry e;
-   auto index_pos = sizeof(e)*block_num;
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= int64_t(index_pos) )
+   if ( !read_entry( block_num, e ) )
       FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block number ${block_num} not contained in block database", ("block_num", block_num));
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
    FC_ASSERT( e.block_id != block_id_type(), "Empty block_id in block_database (maybe corrupt on disk?)" );
    return e.block_id;
 }
@@ -147,24 +341,17 @@ fc::optional<signed_block> block_database::fetch_optional( const block_id_type&
 {
    try
    {
+      std::shared_lock<std::shared_timed_mutex> lock( _file_mutex );
+      if( auto cached = cache_find( id ) )
+         return *cached;
+
       index_entry e;
-      auto index_pos = sizeof(e)*block_header::num_from_id(id);
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( (size_t)_block_num_to_pos.tellg() <= index_pos )
+      if( !read_entry( block_header::num_from_id(id), e ) )
          return {};
 
-      _block_num_to_pos.seekg( index_pos );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
+      if( e.block_id != id || e.block_size == 0 ) return fc::optional<signed_block>();
 
-      if( e.block_id != id ) return fc::optional<signed_block>();
-
-      vector<char> data( e.block_size );
-      _blocks.seekg( e.block_pos );
-      if (e.block_size)
-         _blocks.read( data.data(), e.block_size );
-      auto result = fc::raw::unpack<signed_block>(data);
-      FC_ASSERT( result.id() == e.block_id );
-      return result;
+      return fetch_entry( e );
    }
    catch (const fc::exception&)
    {
@@ -179,21 +366,11 @@ fc::optional<signed_block> block_database::fetch_by_number( uint32_t block_num )
 {
    try
    {
+      std::shared_lock<std::shared_timed_mutex> lock( _file_mutex );
       index_entry e;
-      auto index_pos = sizeof(e)*block_num;
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( (size_t)_block_num_to_pos.tellg() <= index_pos )
+      if( !read_entry( block_num, e ) || e.block_size == 0 )
          return {};
-
-      _block_num_to_pos.seekg( index_pos, _block_num_to_pos.beg );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
-      vector<char> data( e.block_size );
-      _blocks.seekg( e.block_pos );
-      _blocks.read( data.data(), e.block_size );
-      auto result = fc::raw::unpack<signed_block>(data);
-      FC_ASSERT( result.id() == e.block_id );
-      return result;
+      return fetch_entry( e );
    }
    catch (const fc::exception&)
    {
@@ -204,34 +381,37 @@ fc::optional<signed_block> block_database::fetch_by_number( uint32_t block_num )
    return fc::optional<signed_block>();
 }
 
-fc::optional<signed_block> block_database::last()const
+bool block_database::fetch_packed_by_number( uint32_t block_num, vector<char>& data, block_id_type& id )const
 {
    try
    {
+      std::shared_lock<std::shared_timed_mutex> lock( _file_mutex );
       index_entry e;
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
+      if( !read_entry( block_num, e ) )
+         return false;
 
-      if( (size_t)_block_num_to_pos.tellp() < sizeof(index_entry) )
-         return fc::optional<signed_block>();
-
-      _block_num_to_pos.seekg( -sizeof(index_entry), _block_num_to_pos.end );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-      uint64_t pos = _block_num_to_pos.tellg();
-      while( e.block_size == 0 && pos > 0 )
-      {
-         pos -= sizeof(index_entry);
-         _block_num_to_pos.seekg( pos );
-         _block_num_to_pos.read( (char*)&e, sizeof(e) );
-      }
+      data = read_block( e );
+      id = e.block_id;
+      return true;
+   }
+   catch (const fc::exception&)
+   {
+   }
+   catch (const std::exception&)
+   {
+   }
+   return false;
+}
 
-      if( e.block_size == 0 )
+fc::optional<signed_block> block_database::last()const
+{
+   try
+   {
+      std::shared_lock<std::shared_timed_mutex> lock( _file_mutex );
+      index_entry e;
+      if( !read_last_entry( e ) )
          return fc::optional<signed_block>();
-
-      vector<char> data( e.block_size );
-      _blocks.seekg( e.block_pos );
-      _blocks.read( data.data(), e.block_size );
-      auto result = fc::raw::unpack<signed_block>(data);
-      return result;
+      return fetch_entry( e );
    }
    catch (const fc::exception&)
    {
@@ -246,23 +426,9 @@ fc::optional<block_id_type> block_database::last_id()const
 {
    try
    {
+      std::shared_lock<std::shared_timed_mutex> lock( _file_mutex );
       index_entry e;
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-
-      if( (size_t)_block_num_to_pos.tellp() < sizeof(index_entry) )
-         return fc::optional<block_id_type>();
-
-      _block_num_to_pos.seekg( -sizeof(index_entry), _block_num_to_pos.end );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-      uint64_t pos = _block_num_to_pos.tellg();
-      while( e.block_size == 0 && pos > 0 )
-      {
-         pos -= sizeof(index_entry);
-         _block_num_to_pos.seekg( pos );
-         _block_num_to_pos.read( (char*)&e, sizeof(e) );
-      }
-
-      if( e.block_size == 0 )
+      if( !read_last_entry( e ) )
          return fc::optional<block_id_type>();
 
       return e.block_id;
@@ -276,5 +442,56 @@ fc::optional<block_id_type> block_database::last_id()const
    return fc::optional<block_id_type>();
 }
 
+void block_database::set_cache_size( size_t blocks )
+{
+   std::lock_guard<std::mutex> lock( _cache_mutex );
+   _cache_size = blocks;
+   while( _cache.size() > _cache_size )
+   {
+      _cache.erase( _cache_lru.back().first );
+      _cache_lru.pop_back();
+   }
+}
+
+std::shared_ptr<const signed_block> block_database::cache_find( const block_id_type& id )const
+{
+   std::lock_guard<std::mutex> lock( _cache_mutex );
+   auto itr = _cache.find( id );
+   if( itr == _cache.end() )
+      return nullptr;
+   _cache_lru.splice( _cache_lru.begin(), _cache_lru, itr->second );
+   return itr->second->second;
+}
+
+void block_database::cache_insert( const block_id_type& id, std::shared_ptr<const signed_block> b )const
+{
+   std::lock_guard<std::mutex> lock( _cache_mutex );
+   if( _cache_size == 0 )
+      return;
+   auto itr = _cache.find( id );
+   if( itr != _cache.end() )
+   {
+      itr->second->second = std::move( b );
+      _cache_lru.splice( _cache_lru.begin(), _cache_lru, itr->second );
+      return;
+   }
+   _cache_lru.emplace_front( id, std::move( b ) );
+   _cache.emplace( id, _cache_lru.begin() );
+   if( _cache.size() > _cache_size )
+   {
+      _cache.erase( _cache_lru.back().first );
+      _cache_lru.pop_back();
+   }
+}
+
+void block_database::cache_erase( const block_id_type& id )const
+{
+   std::lock_guard<std::mutex> lock( _cache_mutex );
+   auto itr = _cache.find( id );
+   if( itr == _cache.end() )
+      return;
+   _cache_lru.erase( itr->second );
+   _cache.erase( itr );
+}
 
 } }
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/bulk_issuance.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/hardfork.hpp>
+#include <graphene/chain/is_authorized_asset.hpp>
+
+namespace graphene { namespace chain {
+
+bulk_issuance::asset_info& bulk_issuance::get_asset_info( asset_id_type asset )
+{
+   asset_info& info = _assets[asset];
+   if( info.asset == nullptr )
+   {
+      info.asset = &asset( _db );
+      info.dynamic_data = &info.asset->dynamic_asset_data_id( _db );
+   }
+   return info;
+}
+
+asset bulk_issuance::check_supply_overflow( const asset& value )
+{
+   const asset_info& info = get_asset_info( value.asset_id );
+   if( info.current_supply() + value.amount > info.asset->options.max_supply )
+      return asset( info.asset->options.max_supply - info.current_supply(), value.asset_id );
+   return value;
+}
+
+template<typename Operation>
+bool bulk_issuance::apply( const Operation& op )
+{
+   try {
+      op.validate();
+   } catch( const fc::assert_exception& ) {
+      return false;
+   }
+
+   asset_info& info = get_asset_info( op.asset_to_issue.asset_id );
+   const asset_object& a = *info.asset;
+
+   // generic_evaluator::prepare_fee(), the issuer pays the zero fee of these operations in CORE
+   const account_object* issuer = _db.find( op.issuer );
+   if( issuer == nullptr )
+      return false;
+   if( _db.head_block_time() > HARDFORK_419_TIME && !is_authorized_asset( _db, *issuer, asset_id_type()( _db ) ) )
+      return false;
+   if( !not_restricted_account( _db, *issuer, directionality_type::payer ) || issuer->verification_is_required )
+      return false;
+
+   // do_evaluate() of the evaluator
+   if( op.issuer != a.issuer || a.is_market_issued() )
+      return false;
+   const account_object* to_account = _db.find( op.issue_to_account );
+   if( to_account == nullptr )
+      return false;
+   if( !is_authorized_asset( _db, *to_account, a ) || !not_restricted_account( _db, *to_account, directionality_type::receiver ) )
+      return false;
+   if( info.current_supply() + op.asset_to_issue.amount > a.options.max_supply )
+      return false;
+
+   _db.adjust_balance( op.issue_to_account, op.asset_to_issue );
+   info.issued += op.asset_to_issue.amount;
+   // the evaluators return void_result, which is the default result of an applied operation
+   _db.push_applied_operation( op );
+   return true;
+}
+
+bool bulk_issuance::issue( const daily_issue_operation& op )
+{
+   return apply( op );
+}
+
+bool bulk_issuance::issue( const referral_issue_operation& op )
+{
+   return apply( op );
+}
+
+bool bulk_issuance::issue( const fund_payment_operation& op )
+{
+   return apply( op );
+}
+
+void bulk_issuance::flush()
+{
+   for( auto& item : _assets )
+   {
+      asset_info& info = item.second;
+      if( info.issued == 0 )
+         continue;
+      _db.modify( *info.dynamic_data, [&]( asset_dynamic_data_object& data ) {
+         data.current_supply += info.issued;
+      });
+      info.issued = 0;
+   }
+}
+
+} } // graphene::chain
@@ -23,6 +23,7 @@
  */
 
 #include <graphene/chain/database.hpp>
+#include <graphene/chain/bulk_issuance.hpp>
 
 #include <graphene/chain/account_object.hpp>
 #include <graphene/chain/fund_object.hpp>
@@ -48,7 +49,7 @@ asset database::get_balance(account_id_type owner, asset_id_type asset_id) const
 
 asset database::get_balance_for_bonus( account_id_type owner, asset_id_type asset_id )const 
 {
-   asset_object asset_obj = asset_id( *this );
+   const asset_object& asset_obj = asset_id( *this );
    if (asset_obj.params.coin_maturing)
    {
       auto& mat_index = get_index_type<account_mature_balance_index>().indices().get<by_account_asset>();
@@ -66,20 +67,25 @@ asset database::get_balance_for_bonus( account_id_type owner, asset_id_type asse
          return asset(0, asset_id);
       }
       auto balance = itr->get_balance();
-      auto online_info = get( accounts_online_id_type() ).online_info;
-      if (!asset_obj.params.mining || !online_info.size()) return balance;
-      auto account_online = online_info.find(owner);
-      if (account_online == online_info.end()) {
-         return asset( 0, asset_id );
-      }
-      else
-      {
-         balance.amount.value *= account_online->second / 1440.0;
-         return balance;
-      }
+      if (!asset_obj.params.mining || !has_online_info()) return balance;
+      // accounts that did not report their online time get nothing
+      balance.amount.value *= get_online_minutes(owner) / 1440.0;
+      return balance;
    }
 }
 
+bool database::has_online_info()const
+{
+   return !get_index_type<account_online_index>().indices().empty();
+}
+
+uint16_t database::get_online_minutes( account_id_type owner )const
+{
+   const auto& idx = get_index_type<account_online_index>().indices().get<by_account>();
+   auto itr = idx.find( owner );
+   return itr == idx.end() ? 0 : itr->minutes;
+}
+
 asset database::get_mature_balance(account_id_type owner, asset_id_type asset_id) const
 {
 //    auto& owner_account = owner(*this);
@@ -165,8 +171,8 @@ void database::adjust_balance(account_id_type account, asset delta )
 
       if (mat_itr != mat_index.end())
       {
-         modify(*mat_itr, [&](account_mature_balance_object& b) {
-            b.adjust_balance(asset(value, delta.asset_id), delta, asset_params.mandatory_transfer);
+         modify_with_delta(*mat_itr, [&](account_mature_balance_object& b, undo_recorder<account_mature_balance_object>& undo) {
+            b.adjust_balance(asset(value, delta.asset_id), delta, asset_params.mandatory_transfer, undo);
          });
       }
    }
@@ -187,14 +193,16 @@ void database::adjust_bonus_balance(account_id_type account, asset delta)
 
          create<bonus_balances_object>([&](bonus_balances_object& bbo) {
             bbo.owner = account;
-            bbo.adjust_balance(delta, head_block_time(), this);
+            // undo removes a new object as a whole, there is nothing to record
+            undo_recorder<bonus_balances_object> undo( _undo_db, bbo, false );
+            bbo.adjust_balance(delta, head_block_time(), this, undo);
          });
       }
    }
    else
    {
-      modify<bonus_balances_object>(*bonus_balances_itr, [&](bonus_balances_object& bbo) {
-         bbo.adjust_balance(delta, head_block_time(), this);
+      modify_with_delta(*bonus_balances_itr, [&](bonus_balances_object& bbo, undo_recorder<bonus_balances_object>& undo) {
+         bbo.adjust_balance(delta, head_block_time(), this, undo);
       });
    }
 }
@@ -209,18 +217,19 @@ void database::adjust_bonus_balance(account_id_type account, referral_balance_in
 
       create<bonus_balances_object>([&](bonus_balances_object& bbo) {
          bbo.owner = account;
-         bbo.add_referral(ref_info, head_block_time(), this);
+         undo_recorder<bonus_balances_object> undo( _undo_db, bbo, false );
+         bbo.add_referral(ref_info, head_block_time(), this, undo);
       });
    }
    else
    {
-      modify<bonus_balances_object>(*bonus_balances_itr, [&](bonus_balances_object& bbo) {
-         bbo.add_referral(ref_info, head_block_time(), this);
+      modify_with_delta(*bonus_balances_itr, [&](bonus_balances_object& bbo, undo_recorder<bonus_balances_object>& undo) {
+         bbo.add_referral(ref_info, head_block_time(), this, undo);
       });
    }
 }
 
-void database::process_bonus_balances(account_id_type account_id)
+void database::process_bonus_balances(account_id_type account_id, bulk_issuance& issuance)
 {
    auto& index = get_index_type<bonus_balances_index>().indices().get<by_account>();
    auto bonus_balances_itr = index.find(account_id);
@@ -233,8 +242,6 @@ void database::process_bonus_balances(account_id_type account_id)
    const auto edc_asset = get_index_type<asset_index>().indices().get<by_symbol>().find(EDC_ASSET_SYMBOL);
    auto edc_balance = get_balance(account_id, edc_asset->get_id()).amount;
 
-   transaction_evaluation_state eval(this);
-
    for (const bonus_balances_object::bonus_balances_info& balance_info: matured_balances)
    {
       if (!balance_info.balances.size() && !balance_info.referral.quantity) { continue; }
@@ -243,33 +250,27 @@ void database::process_bonus_balances(account_id_type account_id)
       {
          referral_issue_operation r_op;
          r_op.issuer = edc_asset->issuer;
-         r_op.asset_to_issue = check_supply_overflow( edc_asset->amount( balance_info.referral.quantity ) );
+         r_op.asset_to_issue = issuance.check_supply_overflow( edc_asset->amount( balance_info.referral.quantity ) );
          r_op.issue_to_account = account_id;
          r_op.account_balance = edc_balance;
          r_op.history = balance_info.referral.history;
          r_op.rank = balance_info.referral.rank;
-         try {
-            r_op.validate();
-            apply_operation(eval, r_op);
-         } catch (fc::assert_exception& e) { }
+         issuance.issue(r_op);
       }
 
       for (auto blns : balance_info.balances) {
          auto account_balance = get_balance(account_id, blns.first).amount;
          daily_issue_operation op;
          op.issuer = blns.first(*this).issuer;
-         op.asset_to_issue = check_supply_overflow( asset( blns.second, blns.first ) );
+         op.asset_to_issue = issuance.check_supply_overflow( asset( blns.second, blns.first ) );
          op.issue_to_account = account_id;
          op.account_balance = account_balance;
-         try {
-            op.validate();
-            apply_operation(eval, op);
-         } catch (fc::assert_exception& e) {  }
+         issuance.issue(op);
       }
    }
 
-   modify<bonus_balances_object>(*bonus_balances_itr, [&](bonus_balances_object& bbo) {
-      bbo.remove(check_time);
+   modify_with_delta(*bonus_balances_itr, [&](bonus_balances_object& bbo, undo_recorder<bonus_balances_object>& undo) {
+      bbo.remove(check_time, undo);
    });
 }
 
@@ -279,10 +280,7 @@ address database::get_address() {
 
 void database::consider_mining_in_mature_balances()
 {
-   if (!find(accounts_online_id_type())) { return; }
-
-   auto& online_info = get(accounts_online_id_type()).online_info;
-   if ( !online_info.size() ) { return; }
+   if ( !has_online_info() ) { return; }
 
    const auto& asset_idx = get_index_type<asset_index>();
    const auto& account_idx = get_index_type<chain::account_index>();
@@ -295,24 +293,14 @@ void database::consider_mining_in_mature_balances()
       account_idx.inspect_all_objects( [&]( const object& obj )
       {
          const account_object& account = static_cast<const account_object&>( obj );
-         uint16_t mined_minutes = 0;
-
-         try
-         {
-            auto iter = online_info.find(account.get_id());
-            if (iter != online_info.end()) {
-               mined_minutes = iter->second;
-            }
-         }
-         catch (...) {
-            wlog("exception, ${file}:${func}", ("file", __FILE__)("func", __PRETTY_FUNCTION__));
-         }
+         uint16_t mined_minutes = get_online_minutes( account.get_id() );
 
          auto& mat_index = get_index_type<account_mature_balance_index>().indices().get<by_account_asset>();
          auto mat_itr = mat_index.find( boost::make_tuple( account.get_id(), asset.get_id() ) );
          if ( mat_itr == mat_index.end() ) { return; }
-         modify( *mat_itr, [mined_minutes]( account_mature_balance_object& b ) {
-            b.consider_mining( mined_minutes );
+         modify_with_delta( *mat_itr, [mined_minutes]( account_mature_balance_object& b,
+                                                      undo_recorder<account_mature_balance_object>& undo ) {
+            b.consider_mining( mined_minutes, undo );
          });
       });
    });
@@ -320,22 +308,18 @@ void database::consider_mining_in_mature_balances()
 
 void database::consider_mining_old() 
 {
-   auto& online_info = get( accounts_online_id_type() ).online_info;
-   if (!online_info.size()) return;
+   if (!has_online_info()) return;
    const auto& account_idx = get_index_type<chain::account_index>();
    const auto asset = get_index_type<asset_index>().indices().get<by_symbol>().find(EDC_ASSET_SYMBOL);
    account_idx.inspect_all_objects( [&](const chain::object& obj) {
       const chain::account_object& account = static_cast<const chain::account_object&>(obj);
-      uint16_t mined_minutes = 0;
-      try {
-         mined_minutes = online_info.at(account.get_id());
-      } catch(...) { }
+      uint16_t mined_minutes = get_online_minutes(account.get_id());
       //auto balance = get_mature_balance(account.get_id(), asset->get_id()).amount;
       auto& mat_index = get_index_type<account_mature_balance_index>().indices().get<by_account_asset>();
       auto mat_itr = mat_index.find(boost::make_tuple(account.get_id(), asset->get_id()));
       if (mat_itr == mat_index.end()) return;
-      modify(*mat_itr, [mined_minutes](account_mature_balance_object& b) {
-         b.consider_mining(mined_minutes);
+      modify_with_delta(*mat_itr, [mined_minutes](account_mature_balance_object& b, undo_recorder<account_mature_balance_object>& undo) {
+         b.consider_mining(mined_minutes, undo);
       });
    });
 }
@@ -430,30 +414,31 @@ asset database::get_burnt_asset(asset_id_type id)
    return asset(asset_dyn_data_ptr.fee_burnt, id);
 }
 
+const referral_aggregate_index& database::get_referral_index( asset_id_type asset )
+{
+   const auto& tracked = _referral_index->tracked_asset();
+   if( !tracked.valid() || *tracked != asset )
+      _referral_index->rebuild( asset, get_index_type<account_index>(), get_index_type<account_balance_index>(),
+                                get_index_type<account_mature_balance_index>() );
+   return *_referral_index;
+}
+
 void database::issue_referral()
 {
-   const auto& idx = get_index_type<chain::account_index>();
    const auto edc_asset = get_index_type<asset_index>().indices().get<by_symbol>().find(EDC_ASSET_SYMBOL);
-   const auto& bal_idx = get_index_type<account_balance_index>();
-   auto& mat_bal_idx = get_index_type<account_mature_balance_index>();   
    auto& issuer_list = edc_asset->issuer( *this ).blacklisted_accounts;
    auto& alpha_list = ALPHA_ACCOUNT_ID( *this ).blacklisted_accounts;
    int minutes_in_1_day = 1440;
-   auto online_info = get( accounts_online_id_type() ).online_info;
-   double default_online_part = online_info.size() ? 0 : 1;
-   referral_tree rtree( idx, bal_idx, edc_asset->id, account_id_type(), &mat_bal_idx );
-   rtree.form();
-   auto ops = rtree.scan();
+   double default_online_part = has_online_info() ? 0 : 1;
+   auto ops = get_referral_index( edc_asset->id ).scan();
 
-   transaction_evaluation_state eval(this);
+   bulk_issuance issuance(*this);
 
    for( const chain::referral_info& op_info : ops )
    {
       if (  alpha_list.count( op_info.to_account_id ) ) { continue; }
       if ( issuer_list.count( op_info.to_account_id ) ) { continue; }
 
-      if (head_block_time() > HARDFORK_621_TIME) { continue; }
-
       if ( head_block_time() > HARDFORK_620_TIME ) {
          adjust_bonus_balance( op_info.to_account_id, referral_balance_info( op_info.quantity,  op_info.rank, op_info.history ) );
       }
@@ -465,15 +450,13 @@ void database::issue_referral()
 
          if ( (head_block_time() > HARDFORK_618_TIME) && (head_block_time() < HARDFORK_619_TIME) && (default_online_part == 0) )
          {
-            try {
-               online_part = online_info.at(op_info.to_account_id) / (double)minutes_in_1_day;
-            } catch( ... ) { }
+            online_part = get_online_minutes(op_info.to_account_id) / (double)minutes_in_1_day;
          }
          if ( (head_block_time() < HARDFORK_620_TIME) && ( balance.value * 0.0065 * online_part < 1 ) ) { continue; }
 
          referral_issue_operation r_op;
          r_op.issuer = edc_asset->issuer;
-         r_op.asset_to_issue = check_supply_overflow( 
+         r_op.asset_to_issue = issuance.check_supply_overflow(
                                         edc_asset->amount( head_block_time() > HARDFORK_618_TIME && head_block_time() < HARDFORK_619_TIME ? 
                                             op_info.quantity * online_part 
                                             : 
@@ -484,12 +467,10 @@ void database::issue_referral()
          r_op.account_balance = real_balance;
          r_op.history = op_info.history;
          r_op.rank = op_info.rank;
-         try {
-            r_op.validate();
-            apply_operation( eval, r_op );
-         } catch ( fc::assert_exception& e ) { }
+         issuance.issue( r_op );
       }
    }
+   issuance.flush();
 }
 
 fc::optional< vesting_balance_id_type > database::deposit_lazy_vesting(
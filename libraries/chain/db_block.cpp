@@ -37,6 +37,9 @@
 #include <graphene/chain/evaluator.hpp>
 #include <graphene/chain/tree.hpp>
 
+#include <fc/asio.hpp>
+#include <fc/thread/parallel.hpp>
+
 namespace graphene { namespace chain {
 
 bool database::is_known_block( const block_id_type& id )const
@@ -113,7 +116,7 @@ std::vector<block_id_type> database::get_block_ids_on_fork(block_id_type head_of
  *
  * @return true if we switched forks as a result of this push.
  */
-bool database::push_block(const signed_block& new_block, uint32_t skip)
+bool database::push_block(const signed_block& new_block, uint32_t skip, const std::string& source)
 {
   //idump((new_block.block_num())(new_block.id())(new_block.timestamp)(new_block.previous));
    bool result = false;
@@ -121,21 +124,22 @@ bool database::push_block(const signed_block& new_block, uint32_t skip)
       {
          detail::without_pending_transactions( *this, std::move(_pending_tx),
             [&]() {
-               result = _push_block(new_block);
+               result = _push_block(new_block, source);
             });
       });
    return result;
 }
 
-bool database::_push_block(const signed_block& new_block)
+bool database::_push_block(const signed_block& new_block, const std::string& source)
 { try {
    uint32_t skip = get_node_properties().skip_flags;
+
    if( !(skip&skip_fork_db) )
    {
       /// TODO: if the block is greater than the head block and before the next maitenance interval
       // verify that the block signer is in the current set of active witnesses.
 
-      shared_ptr<fork_item> new_head = _fork_db.push_block(new_block);
+      shared_ptr<fork_item> new_head = _fork_db.push_block(new_block, source);
 
       //If the head block from the longest chain does not build off of the current head, we need to switch forks.
       if( new_head->data.previous != head_block_id() )
@@ -145,13 +149,25 @@ bool database::_push_block(const signed_block& new_block)
          if( new_head->data.block_num() > head_block_num() )
          {
             wlog( "Switching to fork: ${id}", ("id",new_head->data.id()) );
+            const auto switch_start = fc::time_point::now();
             auto branches = _fork_db.fetch_branch_from(new_head->data.id(), head_block_id());
+            auto& stats = _fork_switch_stats;
+            ++stats.switches;
+            stats.last_depth = branches.second.size();
+            stats.max_depth = std::max( stats.max_depth, stats.last_depth );
+            auto finish_switch = [&]() {
+               stats.last_duration = fc::time_point::now() - switch_start;
+               stats.max_duration = std::max( stats.max_duration, stats.last_duration );
+               stats.total_duration += stats.last_duration;
+               ilog( "Fork switch over ${d} blocks took ${t} ms",
+                     ("d",stats.last_depth)("t",stats.last_duration.count() / 1000) );
+            };
 
             // pop blocks until we hit the forked block
-            while( head_block_id() != branches.second.back()->data.previous )
+            for( const auto& item : branches.second )
             {
                ilog( "popping block #${n} ${id}", ("n",head_block_num())("id",head_block_id()) );
-               pop_block();
+               pop_fork_block( item );
             }
 
             // push all blocks on the new fork
@@ -160,15 +176,13 @@ bool database::_push_block(const signed_block& new_block)
                 ilog( "pushing blocks from fork ${n} ${id}", ("n",(*ritr)->data.block_num())("id",(*ritr)->data.id()) );
                 optional<fc::exception> except;
                 try {
-                   undo_database::session session = _undo_db.start_undo_session();
-                   apply_block( (*ritr)->data, skip );
-                   _block_id_to_block.store( (*ritr)->id, (*ritr)->data );
-                   session.commit();
+                   push_fork_block( *ritr, skip );
                 }
                 catch ( const fc::exception& e ) { except = e; }
                 if( except )
                 {
                    wlog( "exception thrown while switching forks ${e}", ("e",except->to_detail_string() ) );
+                   ++stats.failed_switches;
                    // remove the rest of branches.first from the fork_db, those blocks are invalid
                    while( ritr != branches.first.rend() )
                    {
@@ -190,17 +204,21 @@ bool database::_push_block(const signed_block& new_block)
                    for( auto ritr2 = branches.second.rbegin(); ritr2 != branches.second.rend(); ++ritr2 )
                    {
                       ilog( "pushing block #${n} ${id}", ("n",(*ritr2)->data.block_num())("id",(*ritr2)->id) );
-                      auto session = _undo_db.start_undo_session();
-                      apply_block( (*ritr2)->data, skip );
-                      _block_id_to_block.store( (*ritr2)->id, (*ritr2)->data );
-                      session.commit();
+                      push_fork_block( *ritr2, skip );
                    }
+                   finish_switch();
                    throw *except;
                 }
             }
+            finish_switch();
+            _fork_db.evict_side_blocks( head_block_id() );
             return true;
          }
-         else return false;
+         else
+         {
+            _fork_db.evict_side_blocks( head_block_id() );
+            return false;
+         }
       }
    }
 
@@ -209,15 +227,82 @@ bool database::_push_block(const signed_block& new_block)
       apply_block(new_block, skip);
       _block_id_to_block.store(new_block.id(), new_block);
       session.commit();
+      if( !(skip & skip_fork_db) )
+         if( auto item = _fork_db.fetch_block( new_block.id() ) )
+            item->listener_changes = std::move( _listener_changes );
    } catch ( const fc::exception& e ) {
       elog("Failed to push new block:\n${e}", ("e", e.to_detail_string()));
       _fork_db.remove(new_block.id());
       throw;
    }
 
+   // apply_block() has matched the block against its checkpoint, so neither it nor the blocks before it can be
+   // undone any more: drop their undo history and the forks that branch off below it
+   auto checkpoint = _checkpoints.find( new_block.block_num() );
+   if( checkpoint != _checkpoints.end() && checkpoint->second == new_block.id() )
+   {
+      _undo_db.clear_history();
+      _fork_db.reset();
+      _fork_db.start_block( new_block );
+   }
+   else if( !(skip & skip_fork_db) )
+      _fork_db.evict_side_blocks( head_block_id() );
+
    return false;
 } FC_CAPTURE_AND_RETHROW( (new_block) ) }
 
+void database::pop_fork_block( const item_ptr& item )
+{
+   FC_ASSERT( head_block_id() == item->id );
+   item->redo.reset();
+   // the block can only be redone if the changes of the applied_block listeners can be left out
+   const auto& changes = item->listener_changes;
+   if( _undo_db.enabled() && _undo_db.size() > 0 && changes && changes->prior )
+   {
+      item->redo = _undo_db.make_redo_state();
+      // the listeners make their changes again when the block is redone
+      item->redo->rewind( *changes->prior );
+      changes->prior.reset();
+   }
+   pop_block();
+}
+
+void database::push_fork_block( const item_ptr& item, uint32_t skip )
+{
+   undo_database::session session = _undo_db.start_undo_session();
+   bool redone = false;
+   auto redo = std::move( item->redo );
+   if( redo && item->listener_changes )
+   {
+      try {
+         auto redo_session = _undo_db.start_undo_session();
+         _undo_db.redo( *redo );
+         redo_session.merge();
+         redone = true;
+      } catch ( const fc::exception& e ) {
+         wlog( "Unable to restore block #${n} ${id}, applying it: ${e}",
+               ("n",item->num)("id",item->id)("e",e.to_detail_string()) );
+      }
+   }
+   if( redone )
+   {
+      // the listeners get the block and its operations like when it was applied
+      _applied_ops = std::move( item->listener_changes->applied_ops );
+      notify_applied_block( item->data );
+      _applied_ops.clear();
+      notify_changed_objects();
+      ++_fork_switch_stats.blocks_redone;
+   }
+   else
+   {
+      apply_block( item->data, skip );
+      ++_fork_switch_stats.blocks_applied;
+   }
+   item->listener_changes = std::move( _listener_changes );
+   _block_id_to_block.store( item->id, item->data );
+   session.commit();
+}
+
 /**
  * Attempts to push the transaction into the pending queue
  *
@@ -237,6 +322,38 @@ processed_transaction database::push_transaction( const signed_transaction& trx,
    return result;
 } FC_CAPTURE_AND_RETHROW( (trx) ) }
 
+void database::precompute_parallel( const signed_block& block )const
+{ try {
+   if( block.transactions.empty() )
+      return;
+
+   // one task per worker thread, each precomputing a contiguous run of transactions
+   const size_t count = block.transactions.size();
+   const size_t threads = std::max<size_t>( 1, fc::asio::default_io_service_scope::get_num_threads() );
+   const size_t chunk = ( count + threads - 1 ) / threads;
+   std::vector<fc::future<void>> workers;
+   workers.reserve( threads );
+   for( size_t base = 0; base < count; base += chunk )
+      workers.push_back( fc::do_parallel( [&block,base,chunk,count] () {
+         for( size_t i = base; i < std::min( base + chunk, count ); ++i )
+         {
+            const processed_transaction& trx = block.transactions[i];
+            trx.id();
+            trx.merkle_digest();
+         }
+      }) );
+
+   // the tasks refer to the block, so all of them must be finished before returning or rethrowing
+   fc::optional<fc::exception> error;
+   for( auto& worker : workers )
+   {
+      try { worker.wait(); }
+      catch( const fc::exception& e ) { if( !error.valid() ) error = e; }
+   }
+   if( error.valid() )
+      throw *error;
+} FC_LOG_AND_RETHROW() }
+
 processed_transaction database::_push_transaction( const signed_transaction& trx )
 {
    // If this is the first transaction pushed after applying a block, start a new undo session.
@@ -395,7 +512,7 @@ signed_block database::_generate_block(
          // We have to recompute pack_size(ptx) because it may be different
          // than pack_size(tx) (i.e. if one or more results increased
          // their size)
-         new_total_size = total_block_size + fc::raw::pack_size( ptx );
+         new_total_size = total_block_size + ptx.packed_size();
          // postpone transaction if it would make block too big
          if( new_total_size > maximum_block_size )
          {
@@ -526,7 +643,7 @@ void database::_apply_block( const signed_block& next_block )
    _applied_ops.clear();
 
    if (!(skip & skip_block_size_check)) {
-      FC_ASSERT( fc::raw::pack_size(next_block) <= get_global_properties().parameters.maximum_block_size );
+      FC_ASSERT( next_block.packed_size() <= get_global_properties().parameters.maximum_block_size );
    }
 
    FC_ASSERT( (skip & skip_merkle_check) || next_block.transaction_merkle_root == next_block.calculate_merkle_root(),
@@ -592,12 +709,29 @@ void database::_apply_block( const signed_block& next_block )
    }
 
    // notify observers that the block has been applied
-   applied_block( next_block ); //emit
+   notify_applied_block( next_block );
    _applied_ops.clear();
 
    notify_changed_objects();
 } FC_CAPTURE_AND_RETHROW( (next_block.block_num()) )  }
 
+void database::notify_applied_block( const signed_block& block )
+{
+   _listener_changes.reset();
+   if( !_undo_db.enabled() || _undo_db.size() == 0 )
+   {
+      applied_block( block ); //emit
+      return;
+   }
+   auto session = _undo_db.start_undo_session();
+   applied_block( block ); //emit
+   auto changes = std::make_shared<applied_block_changes>();
+   changes->prior = _undo_db.copy_prior_state();
+   changes->applied_ops = std::move( _applied_ops );
+   session.merge();
+   _listener_changes = std::move( changes );
+}
+
 void database::notify_changed_objects()
 { try {
    if( _undo_db.enabled() ) 
@@ -605,6 +739,7 @@ void database::notify_changed_objects()
       const auto& head_undo = _undo_db.head();
       vector<object_id_type> changed_ids;  changed_ids.reserve(head_undo.old_values.size());
       for( const auto& item : head_undo.old_values ) changed_ids.push_back(item.first);
+      for( const auto& item : head_undo.old_deltas ) changed_ids.push_back(item.first);
       for( const auto& item : head_undo.new_ids ) changed_ids.push_back(item);
       vector<const object*> removed;
       removed.reserve( head_undo.removed.size() );
@@ -639,10 +774,10 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
    auto trx_id = trx.id();
    if( !(skip & skip_transaction_dupe_check) )
    {
-      GRAPHENE_ASSERT( trx_idx.indices().get<by_trx_id>().find(trx.id()) == trx_idx.indices().get<by_trx_id>().end(),
+      GRAPHENE_ASSERT( trx_idx.indices().get<by_trx_id>().find(trx_id) == trx_idx.indices().get<by_trx_id>().end(),
                        duplicate_transaction,
                        "Transaction '${txid}' is already in the database",
-                       ("txid",trx.id()) );
+                       ("txid",trx_id) );
    }
    transaction_evaluation_state eval_state(this);
    const chain_parameters& chain_parameters = get_global_properties().parameters;
@@ -763,4 +898,10 @@ bool database::before_last_checkpoint()const
    return (_checkpoints.size() > 0) && (_checkpoints.rbegin()->first >= head_block_num());
 }
 
+bool database::is_checkpointed( uint32_t block_num )const
+{
+   return _checkpoints.size() && _checkpoints.rbegin()->second != block_id_type()
+          && _checkpoints.rbegin()->first >= block_num;
+}
+
 } }
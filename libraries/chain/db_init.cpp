@@ -222,20 +222,25 @@ void database::initialize_indexes()
    reset_indexes();
    _undo_db.set_max_size( GRAPHENE_MIN_UNDO_HISTORY );
 
+   // Indexes of objects that are never removed after genesis get a direct_index for O(1) lookups by id.
+   // Objects that are pruned (history, deposits, orders, cheques...) would leave gaps the direct_index
+   // cannot load, these keep the ordered lookup. A flat_index is vector backed already and moves its objects
+   // when it grows, which would leave dangling pointers in a direct_index.
+
    // protocol object indexes
-   add_index<primary_index<asset_index>>();
+   add_index<primary_index<asset_index, 10>>(); // 1024 assets per chunk
    add_index<primary_index<force_settlement_index>>();
-   add_index<primary_index<fund_index>>();
+   add_index<primary_index<fund_index, 8>>(); // 256 funds per chunk
    add_index<primary_index<fund_deposit_index>>();
    add_index<primary_index<cheque_index>>();
 
-   auto acnt_index = add_index<primary_index<account_index>>();
+   auto acnt_index = add_index<primary_index<account_index, 16>>(); // 65536 accounts per chunk
    acnt_index->add_secondary_index<account_member_index>();
-   acnt_index->add_secondary_index<account_referrer_index>();
+   _referral_index = acnt_index->add_secondary_index<referral_aggregate_index>();
 
    add_index<primary_index<restricted_account_index>>();
-   add_index<primary_index<committee_member_index>>();
-   add_index<primary_index<witness_index>>();
+   add_index<primary_index<committee_member_index, 8>>(); // 256 members per chunk
+   add_index<primary_index<witness_index, 10>>(); // 1024 witnesses per chunk
    add_index<primary_index<limit_order_index>>();
    add_index<primary_index<call_order_index>>();
 
@@ -250,9 +255,11 @@ void database::initialize_indexes()
 
    // implementation object indexes
    add_index<primary_index<transaction_index                            >>();
-   add_index<primary_index<account_balance_index                        >>();
-   add_index<primary_index<account_mature_balance_index                 >>();
-   add_index<primary_index<bonus_balances_index                         >>();
+   add_index<primary_index<account_balance_index, 16                    >>()
+      ->add_secondary_index<referral_balance_watcher<account_balance_object>>( _referral_index );
+   add_index<primary_index<account_mature_balance_index, 16             >>()
+      ->add_secondary_index<referral_balance_watcher<account_mature_balance_object>>( _referral_index );
+   add_index<primary_index<bonus_balances_index, 16                     >>();
    add_index<primary_index<asset_bitasset_data_index                    >>();
    add_index<primary_index<simple_index<global_property_object         >>>();
    add_index<primary_index<simple_index<dynamic_global_property_object >>>();
@@ -270,6 +277,7 @@ void database::initialize_indexes()
    add_index<primary_index<simple_index<fba_accumulator_object    >>>();
    add_index<primary_index<simple_index<account_properties_object >>>();
    add_index<primary_index<simple_index<accounts_online_object    >>>();
+   add_index<primary_index<account_online_index                   >>();
    add_index<primary_index<simple_index<fund_statistics_object    >>>();
    add_index<primary_index<simple_index<fund_history_object       >>>();
    add_index<primary_index<simple_index<settings_object           >>>();
@@ -33,6 +33,7 @@
 #include <graphene/chain/account_object.hpp>
 #include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/budget_record_object.hpp>
+#include <graphene/chain/bulk_issuance.hpp>
 #include <graphene/chain/buyback_object.hpp>
 #include <graphene/chain/chain_property_object.hpp>
 #include <graphene/chain/committee_member_object.hpp>
@@ -894,25 +895,30 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
              << ", head_block_time: " << std::string(head_block_time()) << "]"
              << std::endl;
 
-   if (head_block_time() > HARDFORK_627_TIME) {
-      process_accounts();
-   }
+   const fc::time_point_sec forever = fc::time_point_sec::maximum();
+   run_maintenance_stages({
+      { "process_accounts",         HARDFORK_627_TIME,    forever,           &database::process_accounts },
+      { "process_funds",            HARDFORK_622_TIME,    forever,           &database::process_funds },
+      { "process_cheques",          HARDFORK_622_TIME,    forever,           &database::process_cheques },
+      { "issue_bonuses",            HARDFORK_620_TIME,    forever,           &database::issue_bonuses }, // for all assets except EDC
+      { "issue_bonuses_before_620", HARDFORK_617_TIME,    HARDFORK_620_TIME, &database::issue_bonuses_before_620 },
+      { "issue_bonuses_old",        HARDFORK_616_TIME,    HARDFORK_617_TIME, &database::issue_bonuses_old },
+      { "clear_old_entities",       fc::time_point_sec(), forever,           &database::clear_old_entities }
+   });
+}
 
-   if (head_block_time() > HARDFORK_622_TIME)
+void database::run_maintenance_stages( const vector<maintenance_stage>& stages )
+{
+   const fc::time_point_sec now = head_block_time();
+   for( const maintenance_stage& stage : stages )
    {
-      process_funds();
-      process_cheques();
-   }
-
-   if (head_block_time() > HARDFORK_620_TIME) {
-      issue_bonuses(); // for all assets except EDC
-   } else if (head_block_time() > HARDFORK_617_TIME) {
-      issue_bonuses_before_620();
-   } else if (head_block_time() > HARDFORK_616_TIME) {
-      issue_bonuses_old();
+      if( now <= stage.after || now > stage.until )
+         continue;
+      const fc::time_point start = fc::time_point::now();
+      (this->*stage.run)();
+      std::cout << "[maintenance stage " << stage.name << ": "
+                << ( fc::time_point::now() - start ).count() / 1000 << " ms]" << std::endl;
    }
-
-   clear_old_entities();
 }
 
 void database::clear_old_entities()
@@ -971,9 +977,9 @@ void database::clear_old_entities()
    // cancel online_info for all users
    if (head_block_time() > HARDFORK_618_TIME)
    {
-      modify(get(accounts_online_id_type()), [&](accounts_online_object& o) {
-         o.online_info = map<account_id_type, uint16_t>();
-      });
+      const auto& online_idx = get_index_type<account_online_index>().indices().get<by_id>();
+      while (!online_idx.empty())
+         remove(*online_idx.begin());
    }
 }
 
@@ -984,7 +990,7 @@ void database::process_accounts()
    {
       if (acc_obj.edc_transfers_daily_amount_counter > 0)
       {
-         modify(acc_obj, [&](account_object& obj) {
+         typed_modify<account_index>(acc_obj, [&](account_object& obj) {
             obj.edc_transfers_daily_amount_counter = 0;
          });
       }
@@ -1069,7 +1075,8 @@ void database::issue_bonuses()
 
    const auto& asset_idx = get_index_type<asset_index>();
    const auto& idx = get_index_type<chain::account_index>();
-   transaction_evaluation_state eval(this);
+   // the supply of the assets is written once per maintenance, see bulk_issuance
+   bulk_issuance issuance(*this);
 
    auto idx_alpha = idx.indices().get<by_id>().find(ALPHA_ACCOUNT_ID);
    if (idx_alpha == idx.indices().get<by_id>().end()) { return; }
@@ -1097,7 +1104,7 @@ void database::issue_bonuses()
 
          // for maturing
          if ( asset.params.maturing_bonus_balance ) {
-            adjust_bonus_balance( account.id, check_supply_overflow( asset.amount( quantity ) ) );
+            adjust_bonus_balance( account.id, issuance.check_supply_overflow( asset.amount( quantity ) ) );
          }
          else
          {
@@ -1105,24 +1112,30 @@ void database::issue_bonuses()
 
             daily_issue_operation op;
             op.issuer = asset.issuer;
-            op.asset_to_issue = check_supply_overflow( asset.amount( quantity ) );
+            op.asset_to_issue = issuance.check_supply_overflow( asset.amount( quantity ) );
             op.issue_to_account = account.id;
             op.account_balance = real_balance;
-            try {
-               op.validate();
-               apply_operation(eval, op);
-            } catch (fc::assert_exception& e) {  }
+            issuance.issue(op);
          }
       });
    });
-   issue_referral();
+   issuance.flush();
 
-   // applying appropriate bonuses
-   idx.inspect_all_objects( [&](const db::object& obj) {
-      process_bonus_balances(obj.id);
+   run_maintenance_stages({
+      { "issue_referral",        HARDFORK_620_TIME, HARDFORK_621_TIME,                 &database::issue_referral },
+      { "apply_bonus_balances",  HARDFORK_620_TIME, fc::time_point_sec::maximum(),     &database::apply_bonus_balances }
    });
 }
 
+void database::apply_bonus_balances()
+{
+   bulk_issuance issuance(*this);
+   get_index_type<chain::account_index>().inspect_all_objects( [&](const db::object& obj) {
+      process_bonus_balances(obj.id, issuance);
+   });
+   issuance.flush();
+}
+
 void database::issue_bonuses_before_620() 
 {
   if (head_block_time() > HARDFORK_619_TIME)
@@ -1130,21 +1143,16 @@ void database::issue_bonuses_before_620()
       
    const auto& idx = get_index_type<chain::account_index>();
    const auto asset = get_index_type<asset_index>().indices().get<by_symbol>().find(EDC_ASSET_SYMBOL);
-   const auto& bal_idx = get_index_type<account_balance_index>();
-   auto& mat_bal_idx = get_index_type<account_mature_balance_index>();
-   transaction_evaluation_state eval(this);
-   referral_tree rtree( idx, bal_idx, asset->id, account_id_type(), &mat_bal_idx );
+   bulk_issuance issuance(*this);
    auto& issuer_list = asset->issuer(*this).blacklisted_accounts;
    auto& alpha_list = ALPHA_ACCOUNT_ID(*this).blacklisted_accounts;
 
    int minutes_in_1_day = 1440;
-   auto online_info = get( accounts_online_id_type() ).online_info;
-   double default_online_part = online_info.size() ? 0 : 1;
-   rtree.form();
-   auto ops = rtree.scan();
+   double default_online_part = has_online_info() ? 0 : 1;
+   auto ops = get_referral_index( asset->id ).scan();
    idx.inspect_all_objects( [&](const db::object& obj) {
       const chain::account_object& account = static_cast<const chain::account_object&>(obj);
-      process_bonus_balances(account.id);
+      process_bonus_balances(account.id, issuance);
       auto real_balance = get_balance(account.get_id(), asset->get_id()).amount;
       auto balance = get_mature_balance(account.get_id(), asset->get_id()).amount;
       uint64_t quantity = 0.0065 * balance.value;
@@ -1154,9 +1162,7 @@ void database::issue_bonuses_before_620()
       if ( issuer_list.count(account.get_id()) ) return;
       double online_part = default_online_part;
       if (head_block_time() > HARDFORK_618_TIME && head_block_time() < HARDFORK_619_TIME && default_online_part == 0) {
-         try {
-            online_part = online_info.at(account.get_id()) / (double)minutes_in_1_day;
-         } catch(...) {}
+         online_part = get_online_minutes(account.get_id()) / (double)minutes_in_1_day;
       }
       if (head_block_time() > HARDFORK_618_TIME && head_block_time() < HARDFORK_619_TIME)
          quantity *= online_part;
@@ -1169,10 +1175,7 @@ void database::issue_bonuses_before_620()
          op.asset_to_issue = asset->amount(quantity);
          op.issue_to_account = account.id;
          op.account_balance = real_balance;
-         try {
-            op.validate();
-            apply_operation(eval, op);
-         } catch (fc::assert_exception& e) {  }
+         issuance.issue(op);
       }
       auto e = std::find(ops.begin(), ops.end(), account.id);
       if (e == ops.end()) return;
@@ -1192,21 +1195,17 @@ void database::issue_bonuses_before_620()
          r_op.history = e->history;
          r_op.rank = e->rank;
 
-         try
-         {
-            r_op.validate();
-            apply_operation(eval, r_op);
-         }
-         catch (fc::assert_exception& ex) {
-            wlog("Assert exception: ${file}:${func}:${line}:${txt}", ("file", __FILE__)("func", __PRETTY_FUNCTION__)("line", __LINE__)("txt", ex.to_string(fc::log_level::all)));
+         if (!issuance.issue(r_op)) {
+            wlog("Referral bonus of ${a} to ${to} rejected", ("a", r_op.asset_to_issue)("to", r_op.issue_to_account));
          }
       }
    });
    if (head_block_time() > HARDFORK_620_TIME) {
       idx.inspect_all_objects( [&](const db::object& obj) {
-         process_bonus_balances(obj.id);
+         process_bonus_balances(obj.id, issuance);
       });
    }
+   issuance.flush();
 }
 
 void database::issue_bonuses_old() {
@@ -1304,13 +1303,13 @@ void database::clear_account_mature_balance_index() {
    auto& balance_idx = get_index_type<account_balance_index>().indices().get<by_account_asset>();
    for (auto& bal_object: balance_idx)
    {
-      modify(bal_object, [&](account_balance_object& mat_obj) {
+      typed_modify<account_balance_index>(bal_object, [&](account_balance_object& mat_obj) {
          mat_obj.mandatory_transfer = false;
       });
       auto itr = idx.find(boost::make_tuple(bal_object.owner, bal_object.asset_type));
       if (itr != idx.end())
       {
-         modify(*itr, [&](account_mature_balance_object& mat_obj) {
+         typed_modify<account_mature_balance_index>(*itr, [&](account_mature_balance_object& mat_obj) {
             mat_obj.asset_type = bal_object.asset_type;
             mat_obj.balance = bal_object.balance;
             mat_obj.history.clear();
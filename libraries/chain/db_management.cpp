@@ -28,13 +28,86 @@
 #include <graphene/protocol/fee_schedule.hpp>
 
 #include <fc/io/fstream.hpp>
+#include <fc/thread/parallel.hpp>
 
+#include <deque>
 #include <fstream>
 #include <functional>
 #include <iostream>
 
 namespace graphene { namespace chain {
 
+namespace {
+   /**
+    *  Reads and unpacks the blocks to replay on the worker threads, up to window blocks ahead of the block being
+    *  applied.
+    */
+   class replay_prefetcher
+   {
+      public:
+         replay_prefetcher( const block_database& blocks, uint32_t first_block_num, uint32_t last_block_num,
+                            uint32_t window )
+         :_blocks( blocks ), _last_block_num( last_block_num ), _window( window ), _next_num( first_block_num ) {}
+
+         /** waits for the blocks still being fetched, they refer to this object */
+         ~replay_prefetcher() { drain(); }
+
+         /** @return the next block in order, null if it does not exist or is corrupted */
+         std::shared_ptr<signed_block> next()
+         {
+            while( _next_num <= _last_block_num && _pending.size() < _window )
+               fetch( _next_num++ );
+            if( _pending.empty() )
+               return nullptr;
+            auto result = _pending.front().wait();
+            _pending.pop_front();
+            return result;
+         }
+
+         void drain()
+         {
+            for( auto& task : _pending )
+            {
+               // called by the destructor, a failed read only matters to next()
+               try { task.wait(); }
+               catch( ... ) {}
+            }
+            _pending.clear();
+         }
+
+      private:
+         void fetch( uint32_t block_num )
+         {
+            _pending.push_back( fc::do_parallel( [this,block_num] () -> std::shared_ptr<signed_block> {
+               vector<char> data;
+               block_id_type id;
+               if( !_blocks.fetch_packed_by_number( block_num, data, id ) )
+                  return nullptr;
+               try
+               {
+                  auto block = std::make_shared<signed_block>( fc::raw::unpack<signed_block>( data ) );
+                  if( block->id() != id )
+                     return nullptr;
+                  return block;
+               }
+               catch( const fc::exception& )
+               {
+               }
+               catch( const std::exception& )
+               {
+               }
+               return nullptr;
+            }));
+         }
+
+         const block_database&                              _blocks;
+         const uint32_t                                     _last_block_num;
+         const uint32_t                                     _window;
+         uint32_t                                           _next_num;
+         std::deque< fc::future<std::shared_ptr<signed_block>> > _pending;
+   };
+}
+
 database::database()
 {
    initialize_indexes();
@@ -66,12 +139,25 @@ void database::reindex(fc::path data_dir, const genesis_state_type& initial_allo
 
    ilog( "Replaying blocks..." );
    _undo_db.disable();
+   replay_prefetcher prefetcher( _block_id_to_block, 1, last_block_num, 1024 );
+   auto last_report = start;
+   uint32_t last_report_num = 0;
    for( uint32_t i = 1; i <= last_block_num; ++i )
    {
-      if( i % 2000 == 0 ) std::cerr << "   " << double(i*100)/last_block_num << "%   "<<i << " of " <<last_block_num<<"   \n";
-      fc::optional< signed_block > block = _block_id_to_block.fetch_by_number(i);
-      if( !block.valid() )
+      const auto now = fc::time_point::now();
+      if( now - last_report >= fc::seconds(10) )
+      {
+         const double rate = double(i - 1 - last_report_num) * 1000000 / (now - last_report).count();
+         ilog( "Replayed ${n} of ${t} blocks (${p}%), ${r} blocks/s, ${e} s remaining",
+               ("n",i - 1)("t",last_block_num)("p",uint64_t(i - 1) * 100 / last_block_num)("r",uint64_t(rate))
+               ("e",rate > 0 ? uint64_t((last_block_num - i + 1) / rate) : 0) );
+         last_report = now;
+         last_report_num = i - 1;
+      }
+      std::shared_ptr< signed_block > block = prefetcher.next();
+      if( !block )
       {
+         prefetcher.drain();
          wlog( "Reindexing terminated due to gap:  Block ${i} does not exist!", ("i", i) );
          uint32_t dropped_count = 0;
          while( true )
@@ -89,18 +175,105 @@ void database::reindex(fc::path data_dir, const genesis_state_type& initial_allo
          wlog( "Dropped ${n} blocks from after the gap", ("n", dropped_count) );
          break;
       }
-      apply_block(*block, skip_witness_signature |
-                          skip_transaction_signatures |
-                          skip_transaction_dupe_check |
-                          skip_tapos_check |
-                          skip_witness_schedule_check |
-                          skip_authority_check);
+      apply_block(*block, skip_trusted_block_checks);
    }
    _undo_db.enable();
    auto end = fc::time_point::now();
-   ilog( "Done reindexing, elapsed time: ${t} sec", ("t",double((end-start).count())/1000000.0 ) );
+   ilog( "Done reindexing, elapsed time: ${t} sec, ${r} blocks/s", ("t",double((end-start).count())/1000000.0 )
+         ("r",uint64_t(double(head_block_num()) * 1000000 / std::max<int64_t>((end-start).count(), 1))) );
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
+uint32_t database::import_blocks( const block_database& source, uint32_t last_block_num )
+{ try {
+   auto source_last = source.last_id();
+   if( !source_last.valid() )
+      return 0;
+   last_block_num = std::min( last_block_num, block_header::num_from_id( *source_last ) );
+   if( last_block_num <= head_block_num() )
+      return 0;
+
+   replay_prefetcher prefetcher( source, head_block_num() + 1, last_block_num, 1024 );
+   return import_blocks( [&prefetcher] () { return prefetcher.next(); }, last_block_num );
+} FC_CAPTURE_AND_RETHROW( (last_block_num) ) }
+
+uint32_t database::import_blocks( std::istream& in, uint32_t last_block_num )
+{ try {
+   return import_blocks( [&in] () -> std::shared_ptr<signed_block> {
+      uint32_t size = 0;
+      if( !in.read( (char*)&size, sizeof(size) ) )
+         return nullptr;
+      FC_ASSERT( size <= MAX_ARRAY_ALLOC_SIZE, "Invalid block size ${s} in block stream", ("s",size) );
+      vector<char> data( size );
+      FC_ASSERT( in.read( data.data(), size ), "Truncated block in block stream" );
+      return std::make_shared<signed_block>( fc::raw::unpack<signed_block>( data ) );
+   }, last_block_num );
+} FC_CAPTURE_AND_RETHROW( (last_block_num) ) }
+
+uint32_t database::import_blocks( const std::function<std::shared_ptr<signed_block>()>& next, uint32_t last_block_num )
+{
+   ilog( "Importing blocks ${f} to ${l}", ("f",head_block_num() + 1)("l",last_block_num) );
+   // the imported blocks are trusted like the ones replayed by reindex()
+   enable_referrer_mode();
+   _undo_db.disable();
+
+   const auto start = fc::time_point::now();
+   auto last_report = start;
+   uint32_t imported = 0;
+   try
+   {
+      while( head_block_num() < last_block_num )
+      {
+         std::shared_ptr<signed_block> block;
+         try
+         {
+            block = next();
+         }
+         catch( const fc::exception& e )
+         {
+            wlog( "Unable to read block ${n}: ${e}", ("n",head_block_num() + 1)("e",e.to_detail_string()) );
+         }
+         if( !block )
+            break;
+         if( block->block_num() <= head_block_num() )
+            continue;
+         if( block->previous != head_block_id() )
+         {
+            wlog( "Block ${n} does not link to the head block, stopping the import", ("n",block->block_num()) );
+            break;
+         }
+
+         // without undo history a failure leaves the block partially applied, the caller has to reindex
+         apply_block( *block, skip_trusted_block_checks );
+         _block_id_to_block.store( block->id(), *block );
+         ++imported;
+
+         const auto now = fc::time_point::now();
+         if( now - last_report >= fc::seconds(10) )
+         {
+            ilog( "Imported ${n} blocks, head block ${h}", ("n",imported)("h",head_block_num()) );
+            last_report = now;
+         }
+      }
+   }
+   catch( ... )
+   {
+      _undo_db.enable();
+      throw;
+   }
+   _undo_db.enable();
+
+   // start the fork database at the new head, as open() does
+   _fork_db.reset();
+   if( auto head = _block_id_to_block.fetch_optional( head_block_id() ) )
+      _fork_db.start_block( *head );
+
+   const auto elapsed = std::max<int64_t>( (fc::time_point::now() - start).count(), 1 );
+   ilog( "Imported ${n} blocks in ${t} sec, ${r} blocks/s, head block ${h}",
+         ("n",imported)("t",double(elapsed) / 1000000.0)("r",uint64_t(double(imported) * 1000000 / elapsed))
+         ("h",head_block_num()) );
+   return imported;
+}
+
 void database::wipe(const fc::path& data_dir, bool include_blocks)
 {
    ilog("Wiping database", ("include_blocks", include_blocks));
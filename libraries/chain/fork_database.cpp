@@ -25,6 +25,8 @@
 #include <graphene/chain/exceptions.hpp>
 #include <graphene/protocol/fee_schedule.hpp>
 
+#include <unordered_set>
+
 namespace graphene { namespace chain {
 fork_database::fork_database()
 {
@@ -33,6 +35,13 @@ void fork_database::reset()
 {
    _head.reset();
    _index.clear();
+   _unlinked_index.clear();
+   _bytes = 0;
+   for( auto& source : _sources )
+   {
+      source.second.blocks = 0;
+      source.second.bytes = 0;
+   }
 }
 
 void fork_database::pop_block()
@@ -46,7 +55,8 @@ void fork_database::pop_block()
 void     fork_database::start_block(signed_block b)
 {
    auto item = std::make_shared<fork_item>(std::move(b));
-   _index.insert(item);
+   if( _index.insert(item).second )
+      on_insert( item );
    _head = item;
 }
 
@@ -54,18 +64,21 @@ void     fork_database::start_block(signed_block b)
  * Pushes the block into the fork database and caches it if it doesn't link
  *
  */
-shared_ptr<fork_item>  fork_database::push_block(const signed_block& b)
+shared_ptr<fork_item>  fork_database::push_block(const signed_block& b, const std::string& source)
 {
-   auto item = std::make_shared<fork_item>(b);
+   auto item = std::make_shared<fork_item>(b, source);
    try {
       _push_block(item);
    }
    catch ( const unlinkable_block_exception& e )
    {
-      wlog( "Pushing block to fork database that failed to link: ${id}, ${num}", ("id",b.id())("num",b.block_num()) );
+      // not cached, the block is fetched again once its predecessors are known
+      ++_unlinkable;
+      ++_sources[source].unlinkable;
+      wlog( "Pushing block to fork database that failed to link: ${id}, ${num} from ${s}",
+            ("id",b.id())("num",b.block_num())("s",source) );
       wlog( "Head: ${num}, ${id}", ("num",_head->data.block_num())("id",_head->data.id()) );
       throw;
-      _unlinked_index.insert( item );
    }
    return _head;
 }
@@ -88,18 +101,16 @@ void  fork_database::_push_block(const item_ptr& item)
       item->prev = *itr;
    }
 
-   _index.insert(item);
+   if( _index.insert(item).second )
+      on_insert( item );
    if( !_head ) _head = item;
    else if( item->num > _head->num )
    {
       _head = item;
       uint32_t min_num = _head->num - std::min( _max_size, _head->num );
 //      ilog( "min block in fork DB ${n}, max_size: ${m}", ("n",min_num)("m",_max_size) );
-      auto& num_idx = _index.get<block_num>();
-      while( num_idx.size() && (*num_idx.begin())->num < min_num )
-         num_idx.erase( num_idx.begin() );
-      
-      _unlinked_index.get<block_num>().erase(_head->num - _max_size);
+      prune( _index, min_num );
+      prune( _unlinked_index, min_num );
    }
    //_push_next( item );
 }
@@ -118,6 +129,7 @@ void fork_database::_push_next( const item_ptr& new_item )
     while( itr != prev_idx.end() )
     {
        auto tmp = *itr;
+       on_erase( tmp );
        prev_idx.erase( itr );
        _push_block( tmp );
 
@@ -130,29 +142,111 @@ void fork_database::set_max_size( uint32_t s )
    _max_size = s;
    if( !_head ) return;
 
-   { /// index
-      auto& by_num_idx = _index.get<block_num>();
-      auto itr = by_num_idx.begin();
-      while( itr != by_num_idx.end() )
-      {
-         if( (*itr)->num < std::max(int64_t(0),int64_t(_head->num) - _max_size) )
-            by_num_idx.erase(itr);
-         else
-            break;
-         itr = by_num_idx.begin();
-      }
+   const uint32_t min_num = std::max( int64_t(0), int64_t(_head->num) - _max_size );
+   prune( _index, min_num );
+   prune( _unlinked_index, min_num );
+}
+
+void fork_database::set_max_bytes( uint64_t b )
+{
+   _max_bytes = b;
+   if( _bytes > _max_bytes && _head )
+      evict_side_blocks( _head->id );
+}
+
+fork_database_stats fork_database::get_stats()const
+{
+   fork_database_stats result;
+   result.blocks = _index.size() + _unlinked_index.size();
+   result.bytes = _bytes;
+   result.max_bytes = _max_bytes;
+   for( const auto& item : _index )
+   {
+      if( item->redo )
+         result.redo_bytes += item->redo->bytes;
+      if( item->listener_changes && item->listener_changes->prior )
+         result.redo_bytes += item->listener_changes->prior->bytes;
    }
-   { /// unlinked_index
-      auto& by_num_idx = _unlinked_index.get<block_num>();
-      auto itr = by_num_idx.begin();
-      while( itr != by_num_idx.end() )
-      {
-         if( (*itr)->num < std::max(int64_t(0),int64_t(_head->num) - _max_size) )
-            by_num_idx.erase(itr);
-         else
-            break;
-         itr = by_num_idx.begin();
-      }
+   result.unlinkable = _unlinkable;
+   result.evicted = _evicted;
+   result.evicted_bytes = _evicted_bytes;
+   result.sources = _sources;
+   return result;
+}
+
+void fork_database::on_insert( const item_ptr& item )
+{
+   _bytes += item->size;
+   auto& source = _sources[item->source];
+   ++source.blocks;
+   source.bytes += item->size;
+}
+
+void fork_database::on_erase( const item_ptr& item )
+{
+   _bytes -= item->size;
+   auto itr = _sources.find( item->source );
+   if( itr == _sources.end() )
+      return;
+   --itr->second.blocks;
+   itr->second.bytes -= item->size;
+   if( itr->second.blocks == 0 && _sources.size() > max_sources )
+      _sources.erase( itr );
+}
+
+void fork_database::prune( fork_multi_index_type& index, uint32_t min_num )
+{
+   auto& num_idx = index.get<block_num>();
+   while( num_idx.size() && (*num_idx.begin())->num < min_num )
+   {
+      on_erase( *num_idx.begin() );
+      num_idx.erase( num_idx.begin() );
+   }
+}
+
+void fork_database::evict( const item_ptr& item )
+{
+   auto& prev_idx = _index.get<by_previous>();
+   for( auto itr = prev_idx.find( item->id ); itr != prev_idx.end(); itr = prev_idx.find( item->id ) )
+      evict( *itr );
+
+   ++_evicted;
+   _evicted_bytes += item->size;
+   ++_sources[item->source].evicted;
+   on_erase( item );
+   _index.get<block_id>().erase( item->id );
+}
+
+void fork_database::evict_side_blocks( const block_id_type& applied_head )
+{
+   if( _bytes <= _max_bytes || !_head )
+      return;
+   std::unordered_set<block_id_type, std::hash<fc::ripemd160>> head_chain;
+   for( item_ptr item = _head; item; item = item->prev.lock() )
+      head_chain.insert( item->id );
+   for( item_ptr item = fetch_block( applied_head ); item && !head_chain.count( item->id ); item = item->prev.lock() )
+      head_chain.insert( item->id );
+
+   // roots of the side branches, oldest first
+   vector<item_ptr> side_roots;
+   for( const auto& item : _index )
+   {
+      if( head_chain.count( item->id ) )
+         continue;
+      auto prev = item->prev.lock();
+      if( !prev || head_chain.count( prev->id ) )
+         side_roots.push_back( item );
+   }
+   std::sort( side_roots.begin(), side_roots.end(),
+              []( const item_ptr& a, const item_ptr& b ) { return a->received < b->received; } );
+
+   for( const auto& root : side_roots )
+   {
+      if( _bytes <= _max_bytes )
+         break;
+      wlog( "Evicting fork block ${n} ${id} from ${s} and the blocks building on it, fork database holds ${b} bytes",
+            ("n",root->num)("id",root->id)("s",root->source)("b",_bytes) );
+      evict( root );
    }
 }
 
@@ -246,7 +340,12 @@ void fork_database::set_head(shared_ptr<fork_item> h)
 
 void fork_database::remove(block_id_type id)
 {
-   _index.get<block_id>().erase(id);
+   auto& index = _index.get<block_id>();
+   auto itr = index.find(id);
+   if( itr == index.end() )
+      return;
+   on_erase( *itr );
+   index.erase(itr);
 }
 
 } } // graphene::chain
@@ -1,4 +1,5 @@
 #include <graphene/chain/fund_object.hpp>
+#include <graphene/chain/bulk_issuance.hpp>
 #include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/hardfork.hpp>
 #include <fc/uint128.hpp>
@@ -89,6 +90,8 @@ void fund_object::process(database& db) const
    const chain::asset_object& asst = *asset_itr;
 
    transaction_evaluation_state eval(&db);
+   // payments add to the supply of the fund asset once, see bulk_issuance
+   bulk_issuance issuance(db);
 
    // all payments to users
    share_type daily_payments_without_owner;
@@ -128,14 +131,14 @@ void fund_object::process(database& db) const
             asset asst_quantity;
 
             if (db.head_block_time() >= HARDFORK_626_TIME) {
-               asst_quantity = db.check_supply_overflow(asst.amount(dep.daily_payment));
+               asst_quantity = issuance.check_supply_overflow(asst.amount(dep.daily_payment));
             }
             else
             {
                share_type quantity = db.get_deposit_daily_payment(dep.percent, p_rate->period, dep.amount.amount);
 
                if (quantity.value > 0) {
-                  asst_quantity = db.check_supply_overflow(asst.amount(quantity));
+                  asst_quantity = issuance.check_supply_overflow(asst.amount(quantity));
                }
             }
 
@@ -148,11 +151,7 @@ void fund_object::process(database& db) const
                op.asset_to_issue = asst_quantity;
                op.issue_to_account = dep.account_id;
 
-               try
-               {
-                  op.validate();
-                  db.apply_operation(eval, op);
-               } catch (fc::assert_exception& e) { }
+               issuance.issue(op);
 
                daily_payments_without_owner += asst_quantity.amount;
             }
@@ -261,7 +260,7 @@ void fund_object::process(database& db) const
             h_item.daily_payments_without_owner = daily_payments_without_owner;
 
             share_type owner_profit = fund_day_profit - daily_payments_without_owner;
-            const asset& asst_owner_quantity = db.check_supply_overflow(asst.amount(owner_profit));
+            const asset& asst_owner_quantity = issuance.check_supply_overflow(asst.amount(owner_profit));
 
             // std::cout << "old_balance: " << old_balance.value
             //           << ", fund_deposits_sum: " << fund_deposits_sum.value
@@ -275,11 +274,7 @@ void fund_object::process(database& db) const
                op.asset_to_issue = asst_owner_quantity;
                op.issue_to_account = owner;
 
-               try
-               {
-                  op.validate();
-                  db.apply_operation(eval, op);
-               } catch (fc::assert_exception& e) { }
+               issuance.issue(op);
             }
          }
       }
@@ -291,7 +286,7 @@ void fund_object::process(database& db) const
       if (p_rate)
       {
          share_type quantity = std::roundl(db.get_percent(p_rate->day_percent) * (long double)daily_payments_without_owner.value);
-         const asset& asst_owner_quantity = db.check_supply_overflow(asst.amount(quantity));
+         const asset& asst_owner_quantity = issuance.check_supply_overflow(asst.amount(quantity));
 
          if (asst_owner_quantity.amount.value > 0)
          {
@@ -305,11 +300,7 @@ void fund_object::process(database& db) const
             op.asset_to_issue = asst_owner_quantity;
             op.issue_to_account = owner;
 
-            try
-            {
-               op.validate();
-               db.apply_operation(eval, op);
-            } catch (fc::assert_exception& e) { }
+            issuance.issue(op);
          }
       }
       else {
@@ -317,6 +308,8 @@ void fund_object::process(database& db) const
       }
    }
 
+   issuance.flush();
+
 //   // erase overdued deposits if no full-node
 //   if (db.get_history_size() > 0)
 //   {
@@ -25,6 +25,7 @@
 
 #include <graphene/chain/types.hpp>
 #include <graphene/db/generic_index.hpp>
+#include <graphene/db/undo_database.hpp>
 #include <graphene/protocol/account.hpp>
 #include <graphene/protocol/referral_classes.hpp>
 
@@ -153,15 +154,16 @@ namespace graphene { namespace chain {
 
          account_id_type   owner;
          vector<bonus_balances_info>     balances_by_date;
-         void  remove(time_point_sec time_point);
+         void  remove(time_point_sec time_point, undo_recorder<bonus_balances_object>& undo);
          int   get_pos_by_date(time_point_sec time_point) const;
          bonus_balances_info get_balances_by_date(time_point_sec time_point) const;
          vector<bonus_balances_info> balances_before_date(time_point_sec time_point) const;
          asset get_full_balance(asset_id_type asset_id, time_point_sec time_point) const;
          asset get_daily_balance(asset_id_type asset_id, time_point_sec time_point) const;
          asset get_referral_balance(asset_id_type asset_id, time_point_sec time_point) const;
-         void  adjust_balance(const asset& delta, time_point_sec time_point, database* db);
-         void  add_referral(referral_balance_info rbi, time_point_sec time_point, database* db);
+         /// the changing methods report their changes to undo, see object_database::modify_with_delta()
+         void  adjust_balance(const asset& delta, time_point_sec time_point, database* db, undo_recorder<bonus_balances_object>& undo);
+         void  add_referral(referral_balance_info rbi, time_point_sec time_point, database* db, undo_recorder<bonus_balances_object>& undo);
    };
 
    class mature_balances_history
@@ -188,8 +190,10 @@ namespace graphene { namespace chain {
          vector<mature_balances_history> history;
 
          asset get_balance()const { return asset(balance, asset_type); }
-         void  adjust_balance(const asset& delta, const asset& real_balance, const int64_t mandatory_transfer);
-         void  consider_mining(uint16_t minied_minutes);
+         /// the changing methods report their changes to undo, see object_database::modify_with_delta()
+         void  adjust_balance(const asset& delta, const asset& real_balance, const int64_t mandatory_transfer,
+                              undo_recorder<account_mature_balance_object>& undo);
+         void  consider_mining(uint16_t minied_minutes, undo_recorder<account_mature_balance_object>& undo);
    };
 
    class restricted_account_object : public graphene::db::abstract_object<restricted_account_object>
@@ -212,6 +216,24 @@ namespace graphene { namespace chain {
            accounts_online_id_type get_id() { return id; }
    };
 
+   /**
+    * @brief the minutes an account was online since the last maintenance
+    * @ingroup object
+    *
+    * One object per account reported by the last set_online_time_operation. They replace the single
+    * online_info map of accounts_online_object, which is kept empty, so that a report only touches the
+    * entries it changes.
+    */
+   class account_online_object : public abstract_object<account_online_object>
+   {
+       public:
+           static const uint8_t space_id = implementation_ids;
+           static const uint8_t type_id  = impl_account_online_object_type;
+
+           account_id_type owner;
+           uint16_t        minutes = 0;
+   };
+
    /**
     * @brief contains address generated for market exchange
     * @ingroup object
@@ -468,6 +490,9 @@ namespace graphene { namespace chain {
 
          /** maps the referrer to the set of accounts that they have referred */
          map< account_id_type, set<account_id_type> > referred_by;
+
+      protected:
+         account_id_type  before_referrer;
    };
    
    struct SimpleUnit
@@ -585,6 +610,24 @@ namespace graphene { namespace chain {
 
    /////////////////////////////////////
 
+   /**
+    * @ingroup object_index
+    */
+   typedef multi_index_container<
+      account_online_object,
+      indexed_by<
+         ordered_unique< tag<by_id>,      member< object, object_id_type, &object::id > >,
+         ordered_unique< tag<by_account>, member< account_online_object, account_id_type, &account_online_object::owner> >
+      >
+   > account_online_multi_index_type;
+
+   /**
+    * @ingroup object_index
+    */
+   typedef generic_index<account_online_object, account_online_multi_index_type> account_online_index;
+
+   /////////////////////////////////////
+
    /**
     * @ingroup object_index
     */
@@ -719,6 +762,7 @@ MAP_OBJECT_ID_TO_TYPE( graphene::chain::account_balance_object )
 MAP_OBJECT_ID_TO_TYPE( graphene::chain::account_statistics_object )
 MAP_OBJECT_ID_TO_TYPE( graphene::chain::restricted_account_object )
 MAP_OBJECT_ID_TO_TYPE( graphene::chain::accounts_online_object )
+MAP_OBJECT_ID_TO_TYPE( graphene::chain::account_online_object )
 MAP_OBJECT_ID_TO_TYPE( graphene::chain::market_address_object )
 MAP_OBJECT_ID_TO_TYPE( graphene::chain::blind_transfer2_object )
 MAP_OBJECT_ID_TO_TYPE( graphene::chain::bonus_balances_object )
@@ -729,6 +773,7 @@ FC_REFLECT_TYPENAME( graphene::chain::account_balance_object )
 FC_REFLECT_TYPENAME( graphene::chain::account_statistics_object )
 FC_REFLECT_TYPENAME( graphene::chain::restricted_account_object )
 FC_REFLECT_TYPENAME( graphene::chain::accounts_online_object )
+FC_REFLECT_TYPENAME( graphene::chain::account_online_object )
 FC_REFLECT_TYPENAME( graphene::chain::market_address_object )
 FC_REFLECT_TYPENAME( graphene::chain::blind_transfer2_object )
 FC_REFLECT_TYPENAME( graphene::chain::bonus_balances_object )
@@ -739,6 +784,7 @@ GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::chain::account_balance_object
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::chain::account_statistics_object )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::chain::restricted_account_object )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::chain::accounts_online_object )
+GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::chain::account_online_object )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::chain::market_address_object )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::chain::blind_transfer2_object )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::chain::bonus_balances_object )
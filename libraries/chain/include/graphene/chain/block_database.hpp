@@ -22,29 +22,93 @@
  * THE SOFTWARE.
  */
 #pragma once
-#include <fstream>
 #include <graphene/protocol/block.hpp>
 
+#include <list>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
 namespace graphene { namespace chain {
+   /**
+    *  Stores blocks by number in two files: "blocks" holds the packed blocks back to back, "index" holds one
+    *  fixed size entry (position, size, id) per block number.
+    *
+    *  All reads are positional (pread), so any number of threads may read concurrently; store() and remove()
+    *  exclude readers only while they update the files. Recently stored or fetched blocks are kept unpacked in
+    *  a small LRU cache keyed by block id.
+    *
+    *  Blocks may also be stored in zlib compressed chunks of consecutive blocks, see store_compressed(). The
+    *  index entry of such a block points at the chunk and at the block's offset inside the decompressed chunk,
+    *  so compressed and plain blocks can be mixed in the same files; store() always appends plain blocks.
+    */
    class block_database 
    {
       public:
+         static const size_t default_cache_size = 256;
+         /// Upper limit of the decompressed size of a chunk written by store_compressed()
+         static const size_t max_chunk_size = 1 << 23;
+
+         block_database() = default;
+         ~block_database();
+
          void open( const fc::path& dbdir );
          bool is_open()const;
          void flush();
          void close();
 
          void store( const block_id_type& id, const signed_block& b );
+         /**
+          * Appends the given packed blocks as one compressed chunk, their total size must not exceed
+          * @ref max_chunk_size.
+          */
+         void store_compressed( const vector< std::pair<block_id_type, vector<char>> >& blocks );
          void remove( const block_id_type& id );
 
          bool                   contains( const block_id_type& id )const;
          block_id_type          fetch_block_id( uint32_t block_num )const;
          optional<signed_block> fetch_optional( const block_id_type& id )const;
          optional<signed_block> fetch_by_number( uint32_t block_num )const;
+         /**
+          * Reads a block without unpacking it, so that unpacking can happen elsewhere.
+          * @return false if the block does not exist
+          */
+         bool                   fetch_packed_by_number( uint32_t block_num, vector<char>& data, block_id_type& id )const;
          optional<signed_block> last()const;
          optional<block_id_type> last_id()const;
+
+         /// Sets the number of unpacked blocks kept in memory, 0 disables the cache
+         void                   set_cache_size( size_t blocks );
+
       private:
-         mutable std::fstream _blocks;
-         mutable std::fstream _block_num_to_pos;
+         struct index_entry;
+
+         bool                   read_entry( uint32_t block_num, index_entry& e )const;
+         bool                   read_last_entry( index_entry& e )const;
+         vector<char>           read_block( const index_entry& e )const;
+         std::shared_ptr<const std::string> read_chunk( uint64_t chunk_pos )const;
+         optional<signed_block> fetch_entry( const index_entry& e )const;
+
+         std::shared_ptr<const signed_block> cache_find( const block_id_type& id )const;
+         void                   cache_insert( const block_id_type& id, std::shared_ptr<const signed_block> b )const;
+         void                   cache_erase( const block_id_type& id )const;
+
+         int                    _blocks = -1;
+         int                    _block_num_to_pos = -1;
+         uint64_t               _blocks_size = 0;
+         uint64_t               _index_size = 0;
+
+         /// shared by readers, exclusive for store(), remove(), open() and close()
+         mutable std::shared_timed_mutex _file_mutex;
+
+         typedef std::list< std::pair< block_id_type, std::shared_ptr<const signed_block> > > lru_list;
+         mutable std::mutex     _cache_mutex;
+         size_t                 _cache_size = default_cache_size;
+         mutable lru_list       _cache_lru; ///< most recently used first
+         mutable std::unordered_map< block_id_type, lru_list::iterator > _cache;
+
+         /// most recently decompressed chunks by position, so sequential reads decompress each chunk once
+         mutable std::mutex     _chunk_mutex;
+         mutable std::list< std::pair< uint64_t, std::shared_ptr<const std::string> > > _chunks;
    };
 } }
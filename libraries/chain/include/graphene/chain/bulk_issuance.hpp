@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/asset_object.hpp>
+#include <graphene/protocol/asset_ops.hpp>
+#include <graphene/protocol/fund_ops.hpp>
+
+namespace graphene { namespace chain {
+
+   class database;
+
+   /**
+    *  @brief Issues the daily bonuses, referral bonuses and fund payments of a maintenance without the evaluators
+    *
+    *  issue() makes the checks of the evaluator of the operation, adjusts the balance of the receiver and
+    *  pushes the operation as applied, like database::apply_operation() does. An operation the evaluator
+    *  would reject changes nothing, like the fc::assert_exception the callers of apply_operation() catch.
+    *
+    *  The current supply of the issued assets is only written by flush(), once per asset. Until then it must
+    *  be read through check_supply_overflow() of this object, and nothing else may issue or burn the assets.
+    */
+   class bulk_issuance
+   {
+      public:
+         explicit bulk_issuance( database& db ) : _db( db ) {}
+
+         /// database::check_supply_overflow() including the amounts issued since the last flush()
+         asset check_supply_overflow( const asset& value );
+
+         /// @return false if the evaluator would have rejected op
+         bool issue( const daily_issue_operation& op );
+         bool issue( const referral_issue_operation& op );
+         bool issue( const fund_payment_operation& op );
+
+         /// adds the issued amounts to the current supply of their assets
+         void flush();
+
+      private:
+         struct asset_info
+         {
+            const asset_object*              asset = nullptr;
+            const asset_dynamic_data_object* dynamic_data = nullptr;
+            share_type                       issued;
+
+            share_type current_supply()const { return dynamic_data->current_supply + issued; }
+         };
+
+         asset_info& get_asset_info( asset_id_type asset );
+         template<typename Operation>
+         bool apply( const Operation& op );
+
+         database&                              _db;
+         flat_map<asset_id_type, asset_info>    _assets;
+   };
+
+} } // graphene::chain
@@ -30,7 +30,7 @@
 
 #define GRAPHENE_MAX_NESTED_OBJECTS (200)
 
-#define GRAPHENE_CURRENT_DB_VERSION              "GPH2.5"
+#define GRAPHENE_CURRENT_DB_VERSION              "GPH2.6"
 
 #define GRAPHENE_RECENTLY_MISSED_COUNT_INCREMENT 4
 #define GRAPHENE_RECENTLY_MISSED_COUNT_DECREMENT 3
@@ -31,7 +31,7 @@
 #include <graphene/chain/block_database.hpp>
 #include <graphene/chain/genesis_state.hpp>
 #include <graphene/chain/evaluator.hpp>
-#include <graphene/chain/tree.hpp>
+#include <graphene/chain/referral_index.hpp>
 
 #include <graphene/db/object_database.hpp>
 #include <graphene/db/object.hpp>
@@ -40,6 +40,7 @@
 
 #include <fc/log/logger.hpp>
 
+#include <iosfwd>
 #include <map>
 
 namespace graphene { namespace chain {
@@ -54,9 +55,26 @@ namespace graphene { namespace chain {
    class force_settlement_object;
    class limit_order_object;
    class call_order_object;
+   class bulk_issuance;
 
    struct budget_record;
 
+   /**
+    *  Counters of the fork switches done by database::_push_block()
+    */
+   struct fork_switch_stats
+   {
+      uint64_t          switches = 0;          ///< switches to a longer branch, including failed ones
+      uint64_t          failed_switches = 0;   ///< switches that ended on the original branch
+      uint32_t          last_depth = 0;        ///< blocks popped by the last switch
+      uint32_t          max_depth = 0;
+      uint64_t          blocks_redone = 0;     ///< blocks restored from the changes kept in the fork database
+      uint64_t          blocks_applied = 0;    ///< blocks that had to be evaluated
+      fc::microseconds  last_duration;
+      fc::microseconds  max_duration;
+      fc::microseconds  total_duration;
+   };
+
    /**
     *   @class database
     *   @brief tracks the blockchain state in an extensible manner
@@ -84,7 +102,15 @@ namespace graphene { namespace chain {
             skip_assert_evaluation      = 1 << 8,  ///< used while reindexing
             skip_undo_history_check     = 1 << 9,  ///< used while reindexing
             skip_witness_schedule_check = 1 << 10,  ///< used while reindexing
-            skip_validate               = 1 << 11 ///< used prior to checkpoint, skips validate() call on transaction
+            skip_validate               = 1 << 11, ///< used prior to checkpoint, skips validate() call on transaction
+            /// checks skipped for trusted blocks: replayed, imported or covered by a checkpoint
+            skip_trusted_block_checks   = skip_witness_signature |
+                                          skip_transaction_signatures |
+                                          skip_transaction_dupe_check |
+                                          skip_tapos_check |
+                                          skip_merkle_check |
+                                          skip_witness_schedule_check |
+                                          skip_authority_check
          };
 
          /**
@@ -110,6 +136,22 @@ namespace graphene { namespace chain {
           */
          void reindex(fc::path data_dir, const genesis_state_type& initial_allocation = genesis_state_type());
 
+         /**
+          * @brief Apply blocks from a trusted source on top of the head block
+          *
+          * The blocks are applied with skip_trusted_block_checks, as in @ref reindex, and stored in the block database,
+          * so a new node can be bootstrapped from another node's blocks without syncing them over p2p. The import stops
+          * at @p last_block_num, at the end of the source, or at the first block that does not link to the head block.
+          * The blocks are applied without undo history, so if one of them fails the state is left partially applied and
+          * has to be rebuilt with @ref reindex.
+          *
+          * @param source the block database of another node
+          * @return the number of imported blocks
+          */
+         uint32_t import_blocks( const block_database& source, uint32_t last_block_num );
+         /// Same as above, reading a stream of blocks each packed with fc::raw and prefixed by its uint32_t size
+         uint32_t import_blocks( std::istream& in, uint32_t last_block_num );
+
          /**
           * @brief wipe Delete database from disk, and potentially the raw chain as well.
           * @param include_blocks If true, delete the raw chain as well as the database.
@@ -134,6 +176,8 @@ namespace graphene { namespace chain {
          block_id_type              get_block_id_for_num( uint32_t block_num )const;
          optional<signed_block>     fetch_block_by_id( const block_id_type& id )const;
          optional<signed_block>     fetch_block_by_number( uint32_t num )const;
+         /// Sets the number of recently used blocks the block database keeps unpacked in memory
+         void                       set_block_cache_size( size_t blocks ) { _block_id_to_block.set_cache_size( blocks ); }
          const signed_transaction&  get_recent_transaction( const transaction_id_type& trx_id )const;
          std::vector<block_id_type> get_block_ids_on_fork(block_id_type head_of_fork) const;
 
@@ -146,12 +190,26 @@ namespace graphene { namespace chain {
          void                              add_checkpoints( const flat_map<uint32_t,block_id_type>& checkpts );
          const flat_map<uint32_t,block_id_type> get_checkpoints()const { return _checkpoints; }
          bool before_last_checkpoint()const;
+         /// true if block_num is at or below the last checkpoint, such blocks are applied without validation
+         bool is_checkpointed( uint32_t block_num )const;
 
-         bool push_block( const signed_block& b, uint32_t skip = skip_nothing );
+         /// @param source where the block came from, used to attribute the fork database memory
+         bool push_block( const signed_block& b, uint32_t skip = skip_nothing, const std::string& source = std::string() );
          processed_transaction push_transaction( const signed_transaction& trx, uint32_t skip = skip_nothing );
-         bool _push_block( const signed_block& b );
+         bool _push_block( const signed_block& b, const std::string& source = std::string() );
+         const fork_switch_stats& get_fork_switch_stats()const { return _fork_switch_stats; }
+         fork_database_stats get_fork_db_stats()const { return _fork_db.get_stats(); }
+         void set_fork_db_max_bytes( uint64_t max_bytes ) { _fork_db.set_max_bytes( max_bytes ); }
          processed_transaction _push_transaction( const signed_transaction& trx );
 
+         /**
+          *  Precomputes the ids and merkle digests of all transactions in @p block on the fc::do_parallel worker
+          *  pool and caches them on the transactions, so applying the block does not repeat the serialization.
+          *  Signature keys are not recovered, the transactions of a block are applied without checking them.
+          *  Returns when all transactions have been processed.
+          */
+         void precompute_parallel( const signed_block& block )const;
+
          ///@throws fc::exception if the proposed transaction fails to apply.
          processed_transaction push_proposal( const proposal_object& proposal );
 
@@ -301,6 +359,10 @@ namespace graphene { namespace chain {
          asset get_mature_balance(account_id_type owner, asset_id_type asset_id)const;
 
          asset get_balance_for_bonus(account_id_type owner, asset_id_type asset_id)const;
+         /// @return true if any account reported its online time since the last maintenance
+         bool has_online_info()const;
+         /// @return the minutes owner was online since the last maintenance, 0 if it did not report
+         uint16_t get_online_minutes(account_id_type owner)const;
          /// This is an overloaded method.
          asset get_balance(const account_object& owner, const asset_object& asset_obj)const;
          address get_address();
@@ -320,10 +382,16 @@ namespace graphene { namespace chain {
          void adjust_bonus_balance(account_id_type account, asset delta);
          void adjust_bonus_balance(account_id_type account, referral_balance_info ref_info);
 
-         void process_bonus_balances(account_id_type account);
+         /// issues the matured bonus balances of account through issuance
+         void process_bonus_balances(account_id_type account, bulk_issuance& issuance);
+         /// process_bonus_balances() of all accounts
+         void apply_bonus_balances();
          void consider_mining_in_mature_balances();
 
+         /// pays the referral bonuses of EDC, a maintenance stage of issue_bonuses() until HARDFORK_621_TIME
          void issue_referral();
+         /// the referral aggregates of asset, rebuilt from the current objects when another asset was tracked
+         const referral_aggregate_index& get_referral_index( asset_id_type asset );
 
          asset check_supply_overflow(asset value);
 
@@ -464,11 +532,27 @@ namespace graphene { namespace chain {
          //Mark pop_undo() as protected -- we do not want outside calling pop_undo(); it should call pop_block() instead
          void pop_undo() { object_database::pop_undo(); }
          void notify_changed_objects();
+         /**
+          *  Emits applied_block. In an undo session the changes of the listeners are kept apart in
+          *  _listener_changes together with the applied operations, so a block restored from its redo_state can
+          *  be announced again without them.
+          */
+         void notify_applied_block( const signed_block& block );
 
       private:
          optional<undo_database::session>       _pending_tx_session;
          vector< unique_ptr<op_evaluator> >     _operation_evaluators;
 
+         uint32_t import_blocks( const std::function<std::shared_ptr<signed_block>()>& next, uint32_t last_block_num );
+
+         /// pops the head block, keeping its changes in item for a later switch back
+         void pop_fork_block( const item_ptr& item );
+         /// applies a block of a fork branch, from the changes kept by pop_fork_block() if possible
+         void push_fork_block( const item_ptr& item, uint32_t skip );
+         fork_switch_stats                      _fork_switch_stats;
+         /// set by notify_applied_block() for the last applied block
+         shared_ptr<applied_block_changes>      _listener_changes;
+
          template<class Index>
          vector<std::reference_wrapper<const typename Index::object_type>> sort_votable_objects(size_t count)const;
 
@@ -533,6 +617,17 @@ namespace graphene { namespace chain {
 
          template<class... Types>
          void perform_account_maintenance(std::tuple<Types...> helpers);
+
+         /// a step of the maintenance, only executed while after < head_block_time() <= until
+         struct maintenance_stage
+         {
+            const char*         name;
+            fc::time_point_sec  after;
+            fc::time_point_sec  until;
+            void (database::*   run)();
+         };
+         /// executes the stages whose time window contains the head block time and logs the time each one took
+         void run_maintenance_stages( const vector<maintenance_stage>& stages );
          ///@}
          ///@}
 
@@ -542,6 +637,7 @@ namespace graphene { namespace chain {
 
          vector< processed_transaction >        _pending_tx;
          fork_database                          _fork_db;
+         referral_aggregate_index*              _referral_index = nullptr;
 
          /**
           *  Note: we can probably store blocks by block num rather than
@@ -604,3 +700,7 @@ namespace graphene { namespace chain {
    }
 
 } } // namespace graphene::chain
+
+FC_REFLECT( graphene::chain::fork_switch_stats,
+            (switches)(failed_switches)(last_depth)(max_depth)(blocks_redone)(blocks_applied)
+            (last_duration)(max_duration)(total_duration) )
@@ -25,6 +25,8 @@
 #include <graphene/protocol/block.hpp>
 
 #include <graphene/chain/types.hpp>
+#include <graphene/chain/operation_history_object.hpp>
+#include <graphene/db/undo_database.hpp>
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/member.hpp>
@@ -37,10 +39,22 @@ namespace graphene { namespace chain {
    using boost::multi_index_container;
    using namespace boost::multi_index;
 
+   /**
+    *  What the applied_block listeners were given and what they changed for one block, kept apart from the
+    *  changes of the block itself
+    */
+   struct applied_block_changes
+   {
+      vector<optional<operation_history_object>> applied_ops;
+      /// the values the listeners changed, nullptr if they could not be copied
+      shared_ptr<graphene::db::prior_state>      prior;
+   };
+
    struct fork_item
    {
-      fork_item( signed_block d )
-      :num(d.block_num()),id(d.id()),data( std::move(d) ){}
+      fork_item( signed_block d, std::string src = std::string() )
+      :num(d.block_num()),id(d.id()),size(d.packed_size()),source(std::move(src)),
+       received(fc::time_point::now()),data( std::move(d) ){}
 
       block_id_type previous_id()const { return data.previous; }
 
@@ -52,10 +66,41 @@ namespace graphene { namespace chain {
        */
       bool                  invalid = false;
       block_id_type         id;
+      uint32_t              size;      ///< packed size of data
+      std::string           source;    ///< where the block came from, i.e. the peer's endpoint, empty if unknown
+      fc::time_point        received;
       signed_block          data;
+      /**
+       * The changes of this block, kept when it is popped by a fork switch so that switching back
+       * does not have to apply it again.
+       */
+      shared_ptr<graphene::db::redo_state> redo;
+      /// the changes of the applied_block listeners when this block was applied, left out of redo
+      shared_ptr<applied_block_changes>    listener_changes;
    };
    typedef shared_ptr<fork_item> item_ptr;
 
+   /** blocks in the fork database and blocks rejected from one source */
+   struct fork_source_stats
+   {
+      uint32_t blocks = 0;
+      uint64_t bytes = 0;
+      uint64_t unlinkable = 0;   ///< blocks rejected because they did not link
+      uint64_t evicted = 0;      ///< blocks removed to stay within the size limit
+   };
+
+   struct fork_database_stats
+   {
+      uint32_t                          blocks = 0;
+      uint64_t                          bytes = 0;
+      uint64_t                          max_bytes = 0;
+      uint64_t                          redo_bytes = 0;   ///< kept for switching back to popped blocks
+      uint64_t                          unlinkable = 0;
+      uint64_t                          evicted = 0;
+      uint64_t                          evicted_bytes = 0;
+      std::map<std::string,fork_source_stats> sources;
+   };
+
 
    /**
     *  As long as blocks are pushed in order the fork
@@ -73,6 +118,10 @@ namespace graphene { namespace chain {
          typedef vector<item_ptr> branch_type;
          /// The maximum number of blocks that may be skipped in an out-of-order push
          const static int MAX_BLOCK_REORDERING = 1024;
+         /// The default limit of the packed size of all blocks
+         const static uint64_t default_max_bytes = 128 * 1024 * 1024;
+         /// Sources without blocks are forgotten once there are more than this many
+         const static size_t max_sources = 256;
 
          fork_database();
          void reset();
@@ -85,9 +134,11 @@ namespace graphene { namespace chain {
          vector<item_ptr>                 fetch_block_by_number(uint32_t n)const;
 
          /**
+          *  @param source where the block came from, the blocks and bytes in the fork database are counted
+          *  per source
           *  @return the new head block ( the longest fork )
           */
-         shared_ptr<fork_item>            push_block(const signed_block& b);
+         shared_ptr<fork_item>            push_block(const signed_block& b, const std::string& source = std::string());
          shared_ptr<fork_item>            head()const { return _head; }
          void                             pop_block();
 
@@ -112,15 +163,46 @@ namespace graphene { namespace chain {
 
          void set_max_size( uint32_t s );
 
+         /**
+          *  Limits the packed size of all blocks. When it is exceeded, the blocks that are not on the chain of
+          *  the head block are evicted, the ones received first go first. The head chain itself is only limited
+          *  by set_max_size().
+          */
+         void set_max_bytes( uint64_t b );
+         /**
+          *  Enforces the limit of set_max_bytes(). push_block() does not evict, as the head it returns may be on a
+          *  fork the caller has not switched to yet, and switching pops back along the chain the caller has applied.
+          *  @param applied_head the head block the caller has applied, neither its chain nor that of head() is evicted
+          */
+         void evict_side_blocks( const block_id_type& applied_head );
+         fork_database_stats get_stats()const;
+
       private:
          /** @return a pointer to the newly pushed item */
          void _push_block(const item_ptr& b );
          void _push_next(const item_ptr& newly_inserted);
 
+         void on_insert( const item_ptr& item );
+         void on_erase( const item_ptr& item );
+         /// erases the items below min_num from index
+         void prune( fork_multi_index_type& index, uint32_t min_num );
+         /// erases item and all blocks building on it
+         void evict( const item_ptr& item );
+
          uint32_t                 _max_size = 1024;
+         uint64_t                 _max_bytes = default_max_bytes;
+         uint64_t                 _bytes = 0;
+         uint64_t                 _unlinkable = 0;
+         uint64_t                 _evicted = 0;
+         uint64_t                 _evicted_bytes = 0;
+         std::map<std::string,fork_source_stats> _sources;
 
          fork_multi_index_type    _unlinked_index;
          fork_multi_index_type    _index;
          shared_ptr<fork_item>    _head;
    };
 } } // graphene::chain
+
+FC_REFLECT( graphene::chain::fork_source_stats, (blocks)(bytes)(unlinkable)(evicted) )
+FC_REFLECT( graphene::chain::fork_database_stats,
+            (blocks)(bytes)(max_bytes)(redo_bytes)(unlinkable)(evicted)(evicted_bytes)(sources) )
@@ -115,7 +115,8 @@ namespace graphene { namespace chain {
                member<fund_transaction_history_object, operation_history_id_type, &fund_transaction_history_object::operation_id>
             >
          >
-      >
+      >,
+      pool_allocator<fund_transaction_history_object>
    > fund_transaction_history_multi_index_type;
 
    typedef generic_index<fund_transaction_history_object, fund_transaction_history_multi_index_type> fund_transaction_history_index;
@@ -24,9 +24,11 @@
 #pragma once
 #include <graphene/protocol/operations.hpp>
 #include <graphene/db/object.hpp>
+#include <graphene/db/generic_index.hpp>
 #include <boost/multi_index/composite_key.hpp>
 
 namespace graphene { namespace chain {
+   using namespace graphene::db;
 
 /**
  * @brief tracks the history of all logical operations on blockchain state
@@ -76,7 +78,8 @@ typedef multi_index_container<
             composite_key<operation_history_object,
             member<operation_history_object, fc::time_point_sec, &operation_history_object::block_time>>
       >
-   >
+   >,
+   pool_allocator<operation_history_object>
 > operation_history_multi_index_type;
 
 typedef generic_index<operation_history_object, operation_history_multi_index_type> operation_history_index;
@@ -141,7 +144,8 @@ typedef multi_index_container<
             member<account_transaction_history_object, operation_history_id_type, &account_transaction_history_object::operation_id>
          >
       >
-   >
+   >,
+   pool_allocator<account_transaction_history_object>
 > account_transaction_history_multi_index_type;
 
 typedef generic_index<account_transaction_history_object, account_transaction_history_multi_index_type> account_transaction_history_index;
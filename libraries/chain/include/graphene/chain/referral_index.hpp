@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/tree.hpp>
+
+namespace graphene { namespace chain {
+
+   /**
+    *  @brief Keeps the partner counts and sums of referral_tree::form() up to date for the root account 1.2.0
+    *
+    *  Like in form(), an account hangs below its referrer if the referrer has a lower id and below 1.2.0
+    *  otherwise, and each account counts the balances of its descendants up to 7 levels deep. Referrer
+    *  changes come from the account index this index is attached to, balance changes of the tracked asset
+    *  from referral_balance_watcher instances on the balance indexes. All of them are also notified when
+    *  changes are undone, so the aggregates always match the current state.
+    *
+    *  The asset is not known when the indexes are created, nothing is tracked until rebuild() is called.
+    */
+   class referral_aggregate_index : public account_referrer_index
+   {
+      public:
+         struct node
+         {
+            bool                       exists = false;
+            account_id_type            parent;
+            flat_set<account_id_type>  children;
+            int64_t                    balance = 0;
+            int64_t                    mature_balance = 0;   ///< 0 unless mandatory_transfer is set
+            uint32_t                   level_1_partners = 0;
+            uint64_t                   level_1_sum = 0;
+            uint32_t                   level_2_partners = 0;
+            uint32_t                   all_partners = 0;
+            uint64_t                   all_sum = 0;
+         };
+
+         /// the number of levels of descendants counted by each account
+         static const uint32_t max_level = 7;
+
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void object_modified( const object& after  ) override;
+
+         const optional<asset_id_type>& tracked_asset()const { return _asset; }
+         /// starts tracking asset, computing all aggregates from the current objects
+         void rebuild( asset_id_type asset, const account_index& accounts, const account_balance_index& balances,
+                       const account_mature_balance_index& mature_balances );
+
+         void balance_changed( account_id_type owner, asset_id_type asset, int64_t balance );
+         void mature_balance_changed( account_id_type owner, asset_id_type asset, int64_t mature_balance );
+
+         /// @return the same result as referral_tree::form() followed by scan(), in the same order
+         std::list<referral_info> scan()const;
+
+         /// @return the aggregates of account or nullptr if it is unknown
+         const node* find( account_id_type account )const;
+
+      private:
+         node& get_node( account_id_type account );
+         /// the parent form() would choose for account
+         account_id_type parent_of( account_id_type account, account_id_type referrer )const;
+         /// adds (sign 1) or removes (sign -1) a descendant's balances at the given level of ancestor
+         void count( account_id_type ancestor, int64_t balance, int64_t mature_balance, uint32_t level, int sign );
+         /// adds or removes the balances of account to its ancestors
+         void count_in_ancestors( account_id_type account, int sign );
+         /// adds or removes the balances of account and its descendants to the ancestors of account
+         void count_subtree( account_id_type account, int sign );
+         void set_parent( account_id_type account, account_id_type parent );
+         void insert_account( const account_object& a );
+         void remove_account( account_id_type account );
+         void set_balances( account_id_type account, int64_t balance, int64_t mature_balance );
+         void update_candidate( account_id_type account );
+         leaf_info make_leaf( account_id_type account )const;
+
+         optional<asset_id_type>    _asset;
+         vector<node>               _nodes;
+         /// accounts that may have a rank, see referral_tree::set_bonus_percent_new()
+         flat_set<account_id_type>  _candidates;
+   };
+
+   /**
+    *  @brief Forwards the balances of one asset from the account_balance_index or the
+    *  account_mature_balance_index to a referral_aggregate_index
+    */
+   template<typename BalanceObject>
+   class referral_balance_watcher : public secondary_index
+   {
+      public:
+         referral_balance_watcher( referral_aggregate_index* referrals ) : _referrals( referrals ) {}
+
+         virtual void object_inserted( const object& obj ) override { update( obj ); }
+         virtual void object_removed( const object& obj ) override
+         {
+            const BalanceObject& b = static_cast<const BalanceObject&>( obj );
+            forward( b, 0 );
+         }
+         virtual void object_modified( const object& after  ) override { update( after ); }
+
+      private:
+         void update( const object& obj )
+         {
+            const BalanceObject& b = static_cast<const BalanceObject&>( obj );
+            forward( b, b.balance.value );
+         }
+         void forward( const account_balance_object& b, int64_t balance )
+         {
+            _referrals->balance_changed( b.owner, b.asset_type, balance );
+         }
+         void forward( const account_mature_balance_object& b, int64_t balance )
+         {
+            _referrals->mature_balance_changed( b.owner, b.asset_type, b.mandatory_transfer ? balance : 0 );
+         }
+
+         referral_aggregate_index* _referrals;
+   };
+
+} } // graphene::chain
@@ -60,6 +60,8 @@ class referral_tree {
     asset get_balance(account_id_type owner);
     void set_bonus_percents();
     void set_bonus_percents_new();
+    /// assigns the rank of one leaf whose partners and sums are complete
+    static void set_bonus_percent_new(leaf_info& leaf);
 };
 
 }}
\ No newline at end of file
@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/referral_index.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace chain {
+
+referral_aggregate_index::node& referral_aggregate_index::get_node( account_id_type account )
+{
+   if( account.instance.value >= _nodes.size() )
+      _nodes.resize( account.instance.value + 1 );
+   return _nodes[account.instance.value];
+}
+
+const referral_aggregate_index::node* referral_aggregate_index::find( account_id_type account )const
+{
+   if( account.instance.value >= _nodes.size() || !_nodes[account.instance.value].exists )
+      return nullptr;
+   return &_nodes[account.instance.value];
+}
+
+account_id_type referral_aggregate_index::parent_of( account_id_type account, account_id_type referrer )const
+{
+   // form() only finds referrers that were placed before, i.e. that have a lower id
+   if( referrer < account && find( referrer ) != nullptr )
+      return referrer;
+   return account_id_type();
+}
+
+void referral_aggregate_index::count( account_id_type ancestor, int64_t balance, int64_t mature_balance,
+                                      uint32_t level, int sign )
+{
+   node& n = get_node( ancestor );
+   n.all_sum += sign * mature_balance;
+   if( level == 1 )
+      n.level_1_sum += sign * mature_balance;
+   if( balance >= 50 * PRECISION )
+   {
+      n.all_partners += sign;
+      if( level == 1 )
+         n.level_1_partners += sign;
+      if( level == 2 )
+         n.level_2_partners += sign;
+   }
+   update_candidate( ancestor );
+}
+
+void referral_aggregate_index::count_in_ancestors( account_id_type account, int sign )
+{
+   const node& n = get_node( account );
+   const int64_t balance = n.balance;
+   const int64_t mature_balance = n.mature_balance;
+   account_id_type current = account;
+   for( uint32_t level = 1; level <= max_level && current != account_id_type(); ++level )
+   {
+      current = get_node( current ).parent;
+      count( current, balance, mature_balance, level, sign );
+   }
+}
+
+void referral_aggregate_index::count_subtree( account_id_type account, int sign )
+{
+   vector<account_id_type> ancestors;
+   for( account_id_type current = account; ancestors.size() < max_level && current != account_id_type(); )
+   {
+      current = get_node( current ).parent;
+      ancestors.push_back( current );
+   }
+   if( ancestors.empty() )
+      return;
+
+   // descendants at depth d reach the ancestors up to max_level - d levels above account
+   vector<std::pair<account_id_type, uint32_t>> stack{ { account, 0 } };
+   while( !stack.empty() )
+   {
+      const auto item = stack.back();
+      stack.pop_back();
+      const node& n = get_node( item.first );
+      const int64_t balance = n.balance;
+      const int64_t mature_balance = n.mature_balance;
+      if( item.second + 1 < max_level )
+         for( const auto& child : n.children )
+            stack.emplace_back( child, item.second + 1 );
+      for( uint32_t i = 0; i < ancestors.size() && item.second + i + 1 <= max_level; ++i )
+         count( ancestors[i], balance, mature_balance, item.second + i + 1, sign );
+   }
+}
+
+void referral_aggregate_index::set_parent( account_id_type account, account_id_type parent )
+{
+   count_subtree( account, -1 );
+   get_node( get_node( account ).parent ).children.erase( account );
+   get_node( account ).parent = parent;
+   get_node( parent ).children.insert( account );
+   count_subtree( account, 1 );
+}
+
+void referral_aggregate_index::set_balances( account_id_type account, int64_t balance, int64_t mature_balance )
+{
+   const bool exists = get_node( account ).exists;
+   if( exists )
+      count_in_ancestors( account, -1 );
+   node& n = get_node( account );
+   n.balance = balance;
+   n.mature_balance = mature_balance;
+   if( exists )
+      count_in_ancestors( account, 1 );
+   update_candidate( account );
+}
+
+void referral_aggregate_index::update_candidate( account_id_type account )
+{
+   const node& n = get_node( account );
+   // the preconditions of referral_tree::scan(), the rank itself is determined in scan()
+   if( n.exists && n.balance >= 100 * PRECISION && n.mature_balance != 0 && n.level_1_partners >= 5 )
+      _candidates.insert( account );
+   else
+      _candidates.erase( account );
+}
+
+void referral_aggregate_index::insert_account( const account_object& a )
+{
+   const account_id_type id = a.id;
+   get_node( id ).exists = true;
+   if( id != account_id_type() )
+   {
+      const account_id_type parent = parent_of( id, a.referrer );
+      get_node( id ).parent = parent;
+      get_node( parent ).children.insert( id );
+      count_in_ancestors( id, 1 );
+   }
+
+   // accounts with a higher id that were waiting for this referrer
+   auto itr = referred_by.find( id );
+   if( itr != referred_by.end() )
+      for( const auto& referred : itr->second )
+         if( id < referred && find( referred ) != nullptr && get_node( referred ).parent != id )
+            set_parent( referred, id );
+   update_candidate( id );
+}
+
+void referral_aggregate_index::remove_account( account_id_type account )
+{
+   if( find( account ) == nullptr )
+      return;
+   const auto children = get_node( account ).children;
+   for( const auto& child : children )
+      set_parent( child, account_id_type() );
+   if( account != account_id_type() )
+   {
+      count_in_ancestors( account, -1 );
+      get_node( get_node( account ).parent ).children.erase( account );
+   }
+   // keep the balances, the balance objects report their own removal
+   node& n = get_node( account );
+   n.exists = false;
+   n.parent = account_id_type();
+   n.level_1_partners = n.level_2_partners = n.all_partners = 0;
+   n.level_1_sum = n.all_sum = 0;
+   _candidates.erase( account );
+}
+
+void referral_aggregate_index::object_inserted( const object& obj )
+{
+   account_referrer_index::object_inserted( obj );
+   if( _asset.valid() )
+      insert_account( static_cast<const account_object&>(obj) );
+}
+
+void referral_aggregate_index::object_removed( const object& obj )
+{
+   account_referrer_index::object_removed( obj );
+   if( _asset.valid() )
+      remove_account( obj.id );
+}
+
+void referral_aggregate_index::object_modified( const object& after  )
+{
+   account_referrer_index::object_modified( after );
+   if( !_asset.valid() )
+      return;
+   const account_object& a = static_cast<const account_object&>(after);
+   if( a.referrer == before_referrer || a.id == account_id_type() )
+      return;
+   const account_id_type parent = parent_of( a.id, a.referrer );
+   if( parent != get_node( a.id ).parent )
+      set_parent( a.id, parent );
+}
+
+void referral_aggregate_index::balance_changed( account_id_type owner, asset_id_type asset, int64_t balance )
+{
+   if( !_asset.valid() || asset != *_asset )
+      return;
+   set_balances( owner, balance, get_node( owner ).mature_balance );
+}
+
+void referral_aggregate_index::mature_balance_changed( account_id_type owner, asset_id_type asset,
+                                                       int64_t mature_balance )
+{
+   if( !_asset.valid() || asset != *_asset )
+      return;
+   set_balances( owner, get_node( owner ).balance, mature_balance );
+}
+
+void referral_aggregate_index::rebuild( asset_id_type asset, const account_index& accounts,
+                                        const account_balance_index& balances,
+                                        const account_mature_balance_index& mature_balances )
+{
+   _asset = asset;
+   _nodes.clear();
+   _candidates.clear();
+
+   // balances first, so that each account is counted once when it is inserted
+   const auto& bal_idx = balances.indices().get<by_account_asset>();
+   for( const auto& b : bal_idx )
+      if( b.asset_type == asset )
+         get_node( b.owner ).balance = b.balance.value;
+   const auto& mat_idx = mature_balances.indices().get<by_account_asset>();
+   for( const auto& b : mat_idx )
+      if( b.asset_type == asset && b.mandatory_transfer )
+         get_node( b.owner ).mature_balance = b.balance.value;
+
+   for( const auto& a : accounts.indices().get<by_id>() )
+      insert_account( a );
+}
+
+leaf_info referral_aggregate_index::make_leaf( account_id_type account )const
+{
+   const node& n = _nodes[account.instance.value];
+   leaf_info leaf( account, n.balance, n.level_1_partners, n.level_1_sum, n.level_2_partners,
+                   n.all_partners, n.all_sum, 0, n.mature_balance );
+
+   // form() adds the descendants in the order of their ids
+   vector<std::pair<account_id_type, uint32_t>> stack{ { account, 0 } };
+   while( !stack.empty() )
+   {
+      const auto item = stack.back();
+      stack.pop_back();
+      const node& current = _nodes[item.first.instance.value];
+      if( item.second > 0 )
+         leaf.child_balances.emplace_back( item.first, current.mature_balance, item.second );
+      if( item.second < max_level )
+         for( const auto& child : current.children )
+            stack.emplace_back( child, item.second + 1 );
+   }
+   std::sort( leaf.child_balances.begin(), leaf.child_balances.end(),
+              []( const child_balance& a, const child_balance& b ) { return a.account_id < b.account_id; } );
+   return leaf;
+}
+
+std::list<referral_info> referral_aggregate_index::scan()const
+{
+   // scan() walks the tree in preorder with the children in the order of their ids,
+   // which is the order of the paths from the root
+   vector<std::pair<vector<account_id_type>, leaf_info>> leaves;
+   for( const auto& account : _candidates )
+   {
+      leaf_info leaf = make_leaf( account );
+      referral_tree::set_bonus_percent_new( leaf );
+      if( leaf.get_bonus_value() < 1 )
+         continue;
+      vector<account_id_type> path;
+      for( account_id_type current = account; ; current = _nodes[current.instance.value].parent )
+      {
+         path.push_back( current );
+         if( current == account_id_type() )
+            break;
+      }
+      std::reverse( path.begin(), path.end() );
+      leaves.emplace_back( std::move( path ), std::move( leaf ) );
+   }
+   std::sort( leaves.begin(), leaves.end(),
+              []( const std::pair<vector<account_id_type>, leaf_info>& a,
+                  const std::pair<vector<account_id_type>, leaf_info>& b ) { return a.first < b.first; } );
+
+   std::list<referral_info> result;
+   for( auto& item : leaves )
+   {
+      leaf_info& leaf = item.second;
+      result.push_back( referral_info( leaf.account_id, leaf.get_bonus_value(), leaf.rank, leaf.get_child_balances() ) );
+   }
+   return result;
+}
+
+} } // graphene::chain
@@ -123,65 +123,68 @@ namespace graphene { namespace chain {
   void referral_tree::set_bonus_percents_new()
   {
      for (auto &leaf: tree_data)
-     {
-        if (leaf.balance < 100 * PRECISION) { continue; }
+        set_bonus_percent_new(leaf);
+  }
 
-        if (leaf.level_1_partners < 5) { continue; }
-        if (leaf.level_2_partners >= 25)
+  void referral_tree::set_bonus_percent_new(leaf_info& leaf)
+  {
+     if (leaf.balance < 100 * PRECISION) { return; }
+
+     if (leaf.level_1_partners < 5) { return; }
+     if (leaf.level_2_partners >= 25)
+     {
+        if (leaf.balance < 250 * PRECISION) return;
+        if (leaf.all_partners < 125)
         {
-           if (leaf.balance < 250 * PRECISION) continue;
-           if (leaf.all_partners < 125)
-           {
-              leaf.rank = "B";
-              leaf.bonus_percent = 0.04;
-           }
-           else if (leaf.all_partners < 625)
+           leaf.rank = "B";
+           leaf.bonus_percent = 0.04;
+        }
+        else if (leaf.all_partners < 625)
+        {
+           if (leaf.balance >= 500 * PRECISION)
            {
-              if (leaf.balance >= 500 * PRECISION)
-              {
-                 leaf.rank = "C";
-                 leaf.bonus_percent = 0.03;
-              }
+              leaf.rank = "C";
+              leaf.bonus_percent = 0.03;
            }
-           else if (leaf.all_partners < 3125)
+        }
+        else if (leaf.all_partners < 3125)
+        {
+           if (leaf.balance >= 1000 * PRECISION)
            {
-              if (leaf.balance >= 1000 * PRECISION)
-              {
-                 leaf.rank = "D";
-                 leaf.bonus_percent = 0.02;
-              }
+              leaf.rank = "D";
+              leaf.bonus_percent = 0.02;
            }
-           else if (leaf.all_partners < 15625)
+        }
+        else if (leaf.all_partners < 15625)
+        {
+           if (leaf.balance >= 1500 * PRECISION)
            {
-              if (leaf.balance >= 1500 * PRECISION)
-              {
-                 leaf.rank = "E";
-                 leaf.bonus_percent = 0.01;
-              }
+              leaf.rank = "E";
+              leaf.bonus_percent = 0.01;
            }
-           else if (leaf.all_partners < 78125)
+        }
+        else if (leaf.all_partners < 78125)
+        {
+           if (leaf.balance >= 2000 * PRECISION)
            {
-              if (leaf.balance >= 2000 * PRECISION)
-              {
-                 leaf.rank = "F";
-                 leaf.bonus_percent = 0.005;
-              }
-           }
-           else
-              {
-              if (leaf.balance >= 2500 * PRECISION)
-              {
-                 leaf.rank = "G";
-                 leaf.bonus_percent = 0.005;
-              }
+              leaf.rank = "F";
+              leaf.bonus_percent = 0.005;
            }
         }
         else
-        {
-           leaf.rank = "A";
-           leaf.bonus_percent = 0.05;
+           {
+           if (leaf.balance >= 2500 * PRECISION)
+           {
+              leaf.rank = "G";
+              leaf.bonus_percent = 0.005;
+           }
         }
      }
+     else
+     {
+        leaf.rank = "A";
+        leaf.bonus_percent = 0.05;
+     }
   }
 
   tree<leaf_info> referral_tree::form()
@@ -23,6 +23,7 @@
  */
 #pragma once
 #include <graphene/db/index.hpp>
+#include <graphene/db/pool_allocator.hpp>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/ordered_index.hpp>
@@ -55,6 +56,13 @@ namespace graphene { namespace db {
          }
 
          virtual const object&  create(const std::function<void(object&)>& constructor )override
+         {
+            return typed_create( constructor );
+         }
+
+         /** create() without type erasure, see object_database::typed_create() */
+         template<typename Constructor>
+         const ObjectType& typed_create( const Constructor& constructor )
          {
             ObjectType item;
             item.id = get_next_id();
@@ -68,8 +76,15 @@ namespace graphene { namespace db {
          virtual void modify( const object& obj, const std::function<void(object&)>& m )override
          {
             assert(nullptr != dynamic_cast<const ObjectType*>(&obj));
+            typed_modify( static_cast<const ObjectType&>(obj), m );
+         }
+
+         /** modify() without type erasure, see object_database::typed_modify() */
+         template<typename Lambda>
+         void typed_modify( const ObjectType& obj, const Lambda& m )
+         {
             std::exception_ptr exc;
-            auto ok = _indices.modify(_indices.iterator_to(static_cast<const ObjectType&>(obj)),
+            auto ok = _indices.modify(_indices.iterator_to(obj),
                                        [&m, &exc](ObjectType& o) mutable {
                                           try {
                                              m(o);
@@ -122,7 +137,25 @@ namespace graphene { namespace db {
             return result;
          }
 
+         virtual index_memory_stats memory_stats()const override
+         {
+            index_memory_stats result;
+            result.object_count = _indices.size();
+            add_pool_stats( result, _indices.get_allocator() );
+            return result;
+         }
+
       private:
+         template<typename Allocator>
+         static void add_pool_stats( index_memory_stats&, const Allocator& ) {}
+
+         template<typename T>
+         static void add_pool_stats( index_memory_stats& stats, const pool_allocator<T>& alloc )
+         {
+            stats.used_bytes = alloc.pools().used_bytes();
+            stats.reserved_bytes = alloc.pools().reserved_bytes();
+         }
+
          fc::uint128_t _current_hash;
          index_type  _indices;
    };
@@ -28,14 +28,81 @@
 #include <fc/io/json.hpp>
 #include <fc/crypto/sha256.hpp>
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <stack>
+#include <unordered_set>
 
 namespace graphene { namespace db {
    class object_database;
    using fc::path;
 
+   /** identifies index files that start with an index_file_header, older files start with the next object id */
+   const uint64_t index_file_magic  = 0xff00696478666c65ULL;
+   const uint32_t index_file_format = 1;
+
+   /**
+    *  @brief header of the files written by primary_index::save() and save_changes()
+    *
+    *  The header is followed by object_count size-prefixed objects (for delta files preceded by the lists of
+    *  removed and changed ids) and the sha256 of everything before it.
+    */
+   struct index_file_header
+   {
+      uint64_t       magic = index_file_magic;
+      uint32_t       format = index_file_format;
+      object_id_type next_id;
+      fc::sha256     object_version;
+      uint64_t       object_count = 0;
+   };
+
+   /** memory used by the objects of an index, the byte counts are only known for pool allocated indexes */
+   struct index_memory_stats
+   {
+      uint64_t object_count = 0;
+      uint64_t used_bytes = 0;
+      uint64_t reserved_bytes = 0;
+   };
+
+   /**
+    *  Checks the trailing hash of an index file without deserializing any object.
+    *  @return the hash of the file content, for files without a header the hash of the whole file
+    */
+   fc::sha256 verify_index_file( const fc::path& file );
+
+   /**
+    *  @class hashed_ofstream
+    *  @brief binary output file that appends the sha256 of its content when finished
+    */
+   class hashed_ofstream
+   {
+      public:
+         explicit hashed_ofstream( const fc::path& file )
+         :_out( file.generic_string(), std::ofstream::binary | std::ofstream::out | std::ofstream::trunc )
+         {
+            FC_ASSERT( _out, "Unable to open ${f}", ("f",file) );
+         }
+
+         void write( const char* d, size_t s ) { _out.write( d, s ); _enc.write( d, s ); }
+         void put( char c )                    { write( &c, 1 ); }
+
+         fc::sha256 finish()
+         {
+            auto hash = _enc.result();
+            _out.write( hash.data(), hash.data_size() );
+            _out.close();
+            FC_ASSERT( _out, "Unable to write index file" );
+            return hash;
+         }
+
+      private:
+         std::ofstream        _out;
+         fc::sha256::encoder  _enc;
+   };
+
    /**
     * @class index_observer
     * @brief used to get callbacks when objects change
@@ -97,8 +164,17 @@ namespace graphene { namespace db {
           *  Opens the index loading objects from a file
           */
          virtual void open( const fc::path& db ) = 0;
-         virtual void save( const fc::path& db ) = 0;
+         /** @return the hash stored at the end of the written file */
+         virtual fc::sha256 save( const fc::path& db ) = 0;
 
+         /**
+          *  Incremental snapshots: only the objects created, modified or removed since
+          *  the last call to clear_changes() are written to / applied from a delta file.
+          */
+         virtual bool has_changes()const = 0;
+         virtual fc::sha256 save_changes( const fc::path& delta ) = 0;
+         virtual void open_changes( const fc::path& delta ) = 0;
+         virtual void clear_changes() = 0;
 
 
          /** @return the object with id or nullptr if not found */
@@ -135,6 +211,8 @@ namespace graphene { namespace db {
 
          virtual void               object_from_variant( const fc::variant& var, object& obj, uint32_t max_depth )const = 0;
          virtual void               object_default( object& obj )const = 0;
+
+         virtual index_memory_stats memory_stats()const { return index_memory_stats(); }
    };
 
    class secondary_index
@@ -167,6 +245,34 @@ namespace graphene { namespace db {
          /** called just after obj is modified */
          void on_modify( const object& obj );
 
+         /** saves undo and notifies the secondary indexes before obj is modified */
+         void about_to_modify( const object& obj )
+         {
+            save_undo( obj );
+            for( const auto& item : _sindex )
+               item->about_to_modify( obj );
+         }
+
+         /** notifies the secondary indexes and observers after obj was modified */
+         void object_modified( const object& obj )
+         {
+            for( const auto& item : _sindex )
+               item->object_modified( obj );
+            on_modify( obj );
+         }
+
+         /** notifies the secondary indexes and observers after obj was created */
+         void object_inserted( const object& obj )
+         {
+            for( const auto& item : _sindex )
+               item->object_inserted( obj );
+            on_add( obj );
+         }
+
+         /** sum of the hashes of all objects, only maintained while the object_database tracks the fingerprint */
+         fc::uint128_t fingerprint()const                { return _fingerprint; }
+         void          set_fingerprint( fc::uint128_t h ) { _fingerprint = h;    }
+
          template<typename T, typename... Args>
          T* add_secondary_index(Args... args)
          {
@@ -189,6 +295,12 @@ namespace graphene { namespace db {
          vector< shared_ptr<index_observer> >   _observers;
          vector< unique_ptr<secondary_index> >  _sindex;
 
+         /** objects changed since the last snapshot, only tracked when the object_database asks for it */
+         std::unordered_set<object_id_type>     _changed_ids;
+         std::unordered_set<object_id_type>     _removed_ids;
+
+         fc::uint128_t                          _fingerprint = 0;
+
       private:
          object_database& _db;
    };
@@ -249,13 +361,13 @@ namespace graphene { namespace db {
                   next++;
                }
             }
-            FC_ASSERT( nullptr != dynamic_cast<const Object*>(&obj), "Wrong object type!" );
+            assert( nullptr != dynamic_cast<const Object*>(&obj) );
             content[instance >> chunkbits][instance & _mask] = static_cast<const Object*>( &obj );
          }
 
          virtual void object_removed( const object& obj )
          {
-            FC_ASSERT( nullptr != dynamic_cast<const Object*>(&obj), "Wrong object type!" );
+            assert( nullptr != dynamic_cast<const Object*>(&obj) );
             uint64_t instance = obj.id.instance();
             FC_ASSERT( instance < next, "Removing out-of-range object: {id} > {next}!", ("id",obj.id)("next",next) );
             FC_ASSERT( content[instance >> chunkbits][instance & _mask], "Removing non-existent object {id}!", ("id",obj.id) );
@@ -346,37 +458,108 @@ namespace graphene { namespace db {
          virtual void open( const path& db )override
          { 
             if( !fc::exists( db ) ) return;
+            const auto start = fc::time_point::now();
             fc::file_mapping fm( db.generic_string().c_str(), fc::read_only );
             fc::mapped_region mr( fm, fc::read_only, 0, fc::file_size(db) );
             fc::datastream<const char*> ds( (const char*)mr.get_address(), mr.get_size() );
-            fc::sha256 open_ver;
-
-            fc::raw::unpack(ds, _next_id);
-            fc::raw::unpack(ds, open_ver);
-            FC_ASSERT( open_ver == get_object_version(), "Incompatible Version, the serialization of objects in this index has changed" );
-            try {
-               vector<char> tmp;
-               while( ds.remaining() > 0 )
-               {
-                  fc::raw::unpack( ds, tmp );
-                  load( tmp );
-               }
-            } catch ( const fc::exception&  ){}
+
+            const auto header = read_header( ds );
+            _next_id = header.next_id;
+            size_t count = 0;
+            if( header.format == 0 )
+            {
+               for( ; ds.remaining() > 0; ++count )
+                  load( ds );
+            }
+            else
+            {
+               for( ; count < header.object_count; ++count )
+                  load( ds );
+               FC_ASSERT( ds.remaining() == sizeof(fc::sha256), "Unexpected data after ${n} objects in ${f}",
+                          ("n",count)("f",db) );
+            }
+            ilog( "Loaded ${n} objects (${b} bytes) of index ${s}.${t} in ${ms} ms",
+                  ("n",count)("b",mr.get_size())("s",object_space_id())("t",object_type_id())
+                  ("ms",(fc::time_point::now() - start).count() / 1000) );
          }
 
-         virtual void save( const path& db ) override 
+         virtual fc::sha256 save( const path& db ) override 
          {
-            std::ofstream out( db.generic_string(), 
-                               std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
-            FC_ASSERT( out );
-            auto ver  = get_object_version();
-            fc::raw::pack( out, _next_id );
-            fc::raw::pack( out, ver );
+            hashed_ofstream out( db );
+            index_file_header header;
+            header.next_id = _next_id;
+            header.object_version = get_object_version();
+            this->inspect_all_objects( [&header]( const object& ) { ++header.object_count; } );
+            fc::raw::pack( out, header );
             this->inspect_all_objects( [&]( const object& o ) {
-                auto vec = fc::raw::pack( static_cast<const object_type&>(o) );
-                auto packed_vec = fc::raw::pack( vec );
-                out.write( packed_vec.data(), packed_vec.size() );
+                fc::raw::pack( out, fc::raw::pack( static_cast<const object_type&>(o) ) );
             });
+            return out.finish();
+         }
+
+         virtual bool has_changes()const override
+         {
+            return !_changed_ids.empty() || !_removed_ids.empty() || _next_id != _saved_next_id;
+         }
+
+         virtual fc::sha256 save_changes( const path& delta ) override
+         {
+            hashed_ofstream out( delta );
+            index_file_header header;
+            header.next_id = _next_id;
+            header.object_version = get_object_version();
+            header.object_count = _changed_ids.size();
+            fc::raw::pack( out, header );
+            // objects are written in id order, a direct_index only accepts new objects in ascending order
+            vector<object_id_type> changed_ids( _changed_ids.begin(), _changed_ids.end() );
+            std::sort( changed_ids.begin(), changed_ids.end() );
+            fc::raw::pack( out, vector<object_id_type>( _removed_ids.begin(), _removed_ids.end() ) );
+            fc::raw::pack( out, changed_ids );
+            for( const auto& id : changed_ids )
+            {
+               const object* o = DerivedIndex::find( id );
+               FC_ASSERT( o != nullptr, "Changed object ${id} is missing", ("id",id) );
+               fc::raw::pack( out, fc::raw::pack( static_cast<const object_type&>(*o) ) );
+            }
+            return out.finish();
+         }
+
+         /**
+          *  Applies a delta written by save_changes() on top of the loaded objects. Changed objects are
+          *  erased before any of them is re-inserted so that intermediate states cannot violate
+          *  uniqueness constraints of the underlying index.
+          */
+         virtual void open_changes( const path& delta ) override
+         {
+            fc::file_mapping fm( delta.generic_string().c_str(), fc::read_only );
+            fc::mapped_region mr( fm, fc::read_only, 0, fc::file_size(delta) );
+            fc::datastream<const char*> ds( (const char*)mr.get_address(), mr.get_size() );
+            vector<object_id_type> removed_ids;
+            vector<object_id_type> changed_ids;
+
+            const auto header = read_header( ds );
+            _next_id = header.next_id;
+            fc::raw::unpack(ds, removed_ids);
+            fc::raw::unpack(ds, changed_ids);
+            FC_ASSERT( header.format == 0 || header.object_count == changed_ids.size(),
+                       "Object count mismatch in ${f}", ("f",delta) );
+
+            for( const auto& id : removed_ids )
+               unload( id );
+            for( const auto& id : changed_ids )
+               unload( id );
+
+            for( size_t i = 0; i < changed_ids.size(); ++i )
+               load( ds );
+            FC_ASSERT( ds.remaining() == ( header.format == 0 ? 0 : sizeof(fc::sha256) ),
+                       "Unexpected data after ${n} objects in ${f}", ("n",changed_ids.size())("f",delta) );
+         }
+
+         virtual void clear_changes() override
+         {
+            _changed_ids.clear();
+            _removed_ids.clear();
+            _saved_next_id = _next_id;
          }
 
          virtual const object&  load( const std::vector<char>& data )override
@@ -391,18 +574,14 @@ namespace graphene { namespace db {
          virtual const object&  create(const std::function<void(object&)>& constructor )override
          {
             const auto& result = DerivedIndex::create( constructor );
-            for( const auto& item : _sindex )
-               item->object_inserted( result );
-            on_add( result );
+            object_inserted( result );
             return result;
          }
 
          virtual const object& insert( object&& obj ) override
          {
             const auto& result = DerivedIndex::insert( std::move( obj ) );
-            for( const auto& item : _sindex )
-               item->object_inserted( result );
-            on_add( result );
+            object_inserted( result );
             return result;
          }
 
@@ -416,13 +595,9 @@ namespace graphene { namespace db {
 
          virtual void modify( const object& obj, const std::function<void(object&)>& m )override
          {
-            save_undo( obj );
-            for( const auto& item : _sindex )
-               item->about_to_modify( obj );
+            about_to_modify( obj );
             DerivedIndex::modify( obj, m );
-            for( const auto& item : _sindex )
-               item->object_modified( obj );
-            on_modify( obj );
+            object_modified( obj );
          }
 
          virtual void add_observer( const shared_ptr<index_observer>& o ) override
@@ -449,8 +624,64 @@ namespace graphene { namespace db {
          }
 
       private:
+         /**
+          *  Deserializes the next size-prefixed object directly from the (memory mapped) stream into
+          *  the index, without copying its packed form into a temporary buffer first.
+          */
+         const object& load( fc::datastream<const char*>& ds )
+         {
+            fc::unsigned_int size;
+            fc::raw::unpack( ds, size );
+            FC_ASSERT( size.value <= ds.remaining(), "Truncated object in index ${s}.${t}",
+                       ("s",object_space_id())("t",object_type_id()) );
+            fc::datastream<const char*> obj_ds( ds.pos(), size.value );
+            object_type obj;
+            fc::raw::unpack( obj_ds, obj );
+            ds.skip( size.value );
+            const auto& result = DerivedIndex::insert( std::move( obj ) );
+            for( const auto& item : _sindex )
+               item->object_inserted( result );
+            return result;
+         }
+
+         /** reads the file header, files written before the header was introduced are reported as format 0 */
+         index_file_header read_header( fc::datastream<const char*>& ds )const
+         {
+            index_file_header header;
+            uint64_t magic = 0;
+            if( ds.remaining() >= sizeof(magic) )
+               memcpy( &magic, ds.pos(), sizeof(magic) );
+            if( magic == index_file_magic )
+            {
+               fc::raw::unpack( ds, header );
+               FC_ASSERT( header.format <= index_file_format, "Unsupported index file format ${f}", ("f",header.format) );
+            }
+            else
+            {
+               header.format = 0;
+               fc::raw::unpack( ds, header.next_id );
+               fc::raw::unpack( ds, header.object_version );
+            }
+            FC_ASSERT( header.object_version == get_object_version(), "Incompatible Version, the serialization of objects in this index has changed" );
+            return header;
+         }
+
+         /** removes an object while loading, bypassing undo and observers */
+         void unload( object_id_type id )
+         {
+            const object* o = DerivedIndex::find( id );
+            if( o == nullptr ) return;
+            for( const auto& item : _sindex )
+               item->object_removed( *o );
+            DerivedIndex::remove( *o );
+         }
+
          object_id_type                                 _next_id;
+         object_id_type                                 _saved_next_id;
          const direct_index< object_type, DirectBits >* _direct_by_id = nullptr;
    };
 
 } } // graphene::db
+
+FC_REFLECT( graphene::db::index_file_header, (magic)(format)(next_id)(object_version)(object_count) )
+FC_REFLECT( graphene::db::index_memory_stats, (object_count)(used_bytes)(reserved_bytes) )
@@ -77,6 +77,9 @@ namespace graphene { namespace db {
 
          /// these methods are implemented for derived classes by inheriting abstract_object<DerivedClass>
          virtual unique_ptr<object> clone()const = 0;
+         /// copy-constructs the object into storage of at least storage_size() bytes, @see undo_arena
+         virtual object*            clone_into( void* storage )const = 0;
+         virtual size_t             storage_size()const = 0;
          virtual void               move_from( object& obj ) = 0;
          virtual variant            to_variant()const  = 0;
          virtual vector<char>       pack()const = 0;
@@ -98,6 +101,11 @@ namespace graphene { namespace db {
          {
             return unique_ptr<object>(new DerivedClass( *static_cast<const DerivedClass*>(this) ));
          }
+         virtual object* clone_into( void* storage )const
+         {
+            return new (storage) DerivedClass( *static_cast<const DerivedClass*>(this) );
+         }
+         virtual size_t  storage_size()const { return sizeof(DerivedClass); }
 
          virtual void    move_from( object& obj )
          {
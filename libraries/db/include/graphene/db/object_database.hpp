@@ -32,6 +32,29 @@
 
 namespace graphene { namespace db {
 
+   /**
+    *  @brief describes the files of an on-disk object_database snapshot
+    *
+    *  A snapshot consists of one full file per index plus up to @ref generation delta files per index,
+    *  each written by an incremental flush. Every file is listed together with its checksum.
+    */
+   struct snapshot_manifest
+   {
+      uint32_t                            generation = 0;
+      flat_map<std::string, fc::sha256>   checksums;
+   };
+
+   /**
+    *  Order independent hashes of the objects in every index, keyed by "space.type", and a digest over all of
+    *  them. Nodes with the same state have the same fingerprint, comparing the per index hashes shows where
+    *  two diverging nodes differ.
+    */
+   struct state_fingerprint
+   {
+      fc::sha256                              digest;
+      flat_map<std::string, fc::uint128_t>    indexes;
+   };
+
    /**
     *   @class object_database
     *   @brief maintains a set of indexed objects that can be modified with multi-level rollback support
@@ -42,14 +65,41 @@ namespace graphene { namespace db {
          object_database();
          ~object_database();
 
-         void reset_indexes() { _index.clear(); _index.resize(255); }
+         void reset_indexes() { _index.clear(); _index.resize(255); _primary_index.clear(); _primary_index.resize(255); }
 
          void open(const fc::path& data_dir );
+         /**
+          * Checks the hashes of the snapshot in data_dir without loading it, throws if the snapshot is
+          * corrupted. open() performs the same check before loading any object.
+          */
+         void verify( const fc::path& data_dir )const;
 
          /**
-          * Saves the complete state of the object_database to disk, this could take a while
+          * Saves the state of the object_database to disk. If incremental snapshots are enabled and the
+          * on-disk snapshot is known to match the last flushed state, only objects changed since then are
+          * written, otherwise the complete state is rewritten which could take a while.
           */
          void flush();
+         /**
+          * Sets the number of incremental flushes between two full rewrites of the snapshot, 0 disables
+          * incremental flushes.
+          */
+         void set_snapshot_compaction_interval( uint32_t interval ) { _compaction_interval = interval; }
+         bool tracking_changes()const { return _track_changes; }
+
+         /** Hashes every index on the worker threads, ignoring the incrementally maintained hashes */
+         state_fingerprint compute_state_fingerprint()const;
+         /**
+          * From now on the hash of every index is updated by the primary_index hooks whenever an object is
+          * created, modified or removed, which makes get_state_fingerprint() cheap.
+          */
+         void enable_state_fingerprint();
+         bool tracking_fingerprint()const { return _track_fingerprint; }
+         /** @return the incrementally maintained fingerprint if enabled, otherwise compute_state_fingerprint() */
+         state_fingerprint get_state_fingerprint()const;
+
+         /** @return the memory used by every index, keyed by "space.type" */
+         flat_map<std::string, index_memory_stats> get_memory_stats()const;
          void wipe(const fc::path& data_dir); // remove from disk
          void close();
 
@@ -91,6 +141,45 @@ namespace graphene { namespace db {
             get_mutable_index(obj.id).modify(obj,m);
          }
 
+         /**
+          *  Like modify(), but instead of saving a full copy of obj for undo, only the changes the modifier
+          *  reports to the undo_recorder<T> passed as its second argument are saved. Every change has to be
+          *  reported before it is made. Meant for objects with large containers of which little changes.
+          */
+         template<typename T, typename Lambda>
+         void modify_with_delta( const T& obj, const Lambda& m ) {
+            const bool record = _undo_db.begin_delta( obj );
+            get_mutable_index(obj.id).modify( obj, [&]( T& o ) {
+               undo_recorder<T> recorder( _undo_db, o, record );
+               m( o, recorder );
+            } );
+         }
+
+         /**
+          *  Same as modify(), but the modifier is applied by the multi_index container of IndexType directly,
+          *  without wrapping it into a std::function and without virtual calls. Undo and secondary indexes are
+          *  maintained as usual. IndexType must be a generic_index, meant for loops that modify many objects.
+          */
+         template<typename IndexType, typename Lambda>
+         void typed_modify( const typename IndexType::object_type& obj, const Lambda& m ) {
+            typedef typename IndexType::object_type T;
+            auto& idx = get_mutable_index_type<IndexType>();
+            auto& hooks = *_primary_index[T::space_id][T::type_id];
+            hooks.about_to_modify( obj );
+            idx.typed_modify( obj, m );
+            hooks.object_modified( obj );
+         }
+
+         /** Same as create(), with the typed path of typed_modify() */
+         template<typename IndexType, typename Constructor>
+         const typename IndexType::object_type& typed_create( const Constructor& constructor ) {
+            typedef typename IndexType::object_type T;
+            auto& idx = get_mutable_index_type<IndexType>();
+            const T& result = idx.typed_create( constructor );
+            _primary_index[T::space_id][T::type_id]->object_inserted( result );
+            return result;
+         }
+
          ///@}
 
          template<typename T>
@@ -136,11 +225,15 @@ namespace graphene { namespace db {
          {
             typedef typename IndexType::object_type ObjectType;
             if( _index[ObjectType::space_id].size() <= ObjectType::type_id  )
+            {
                 _index[ObjectType::space_id].resize( 255 );
+                _primary_index[ObjectType::space_id].resize( 255, nullptr );
+            }
             assert(!_index[ObjectType::space_id][ObjectType::type_id]);
-            unique_ptr<index> indexptr( new IndexType(*this) );
-            _index[ObjectType::space_id][ObjectType::type_id] = std::move(indexptr);
-            return static_cast<IndexType*>(_index[ObjectType::space_id][ObjectType::type_id].get());
+            IndexType* result = new IndexType(*this);
+            _index[ObjectType::space_id][ObjectType::type_id] = unique_ptr<index>( result );
+            _primary_index[ObjectType::space_id][ObjectType::type_id] = result;
+            return result;
          }
 
          template<typename IndexType, typename SecondaryIndexType, typename... Args>
@@ -174,10 +267,31 @@ namespace graphene { namespace db {
          void save_undo_add( const object& obj );
          void save_undo_remove( const object& obj );
 
+         void flush_changes();
+         void start_tracking_changes();
+         void write_manifest( const fc::path& dir, const snapshot_manifest& manifest )const;
+         fc::optional<snapshot_manifest> read_manifest( const fc::path& dir )const;
+         /** @return the files of an index in the order they have to be loaded, relative to dir */
+         std::vector<fc::path> snapshot_files( const fc::path& dir, uint32_t space, uint32_t type,
+                                               const fc::optional<snapshot_manifest>& manifest )const;
+         void verify_snapshot( const fc::path& dir, const fc::optional<snapshot_manifest>& manifest )const;
+         /** computes the hash of every index in parallel, calling handler( space, type, hash ) in index order */
+         void hash_indexes( const std::function<void(uint32_t,uint32_t,fc::uint128_t)>& handler )const;
+
          fc::path                                                  _data_dir;
          vector< vector< unique_ptr<index> > >                     _index;
+         /** the base_primary_index of every index in _index, used by typed_modify() and typed_create() */
+         vector< vector< base_primary_index* > >                   _primary_index;
+
+         snapshot_manifest                                         _manifest;
+         uint32_t                                                  _compaction_interval = 0;
+         bool                                                      _track_changes = false;
+         bool                                                      _track_fingerprint = false;
    };
 
 } } // graphene::db
 
+FC_REFLECT( graphene::db::snapshot_manifest, (generation)(checksums) )
+FC_REFLECT( graphene::db::state_fingerprint, (digest)(indexes) )
+
 
@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace graphene { namespace db {
+
+   /**
+    *  @class node_pool
+    *  @brief free list of memory blocks of one size, taken from the system in chunks of growing size
+    *
+    *  Not thread safe, every container owns its pools.
+    */
+   class node_pool
+   {
+      public:
+         explicit node_pool( size_t node_size )
+         :_node_size( round_up( std::max( node_size, sizeof(void*) ) ) ) {}
+         ~node_pool() { release(); }
+
+         node_pool( const node_pool& ) = delete;
+         node_pool& operator=( const node_pool& ) = delete;
+
+         void* allocate()
+         {
+            if( _free == nullptr )
+               grow();
+            void* result = _free;
+            _free = *static_cast<void**>( _free );
+            ++_used;
+            return result;
+         }
+
+         void deallocate( void* p )
+         {
+            // kept for reuse, the header node of a multi_index container lives as long as the container
+            *static_cast<void**>( p ) = _free;
+            _free = p;
+            --_used;
+         }
+
+         size_t node_size()const      { return _node_size; }
+         size_t used_bytes()const     { return _used * _node_size; }
+         size_t reserved_bytes()const { return _reserved * _node_size; }
+
+         /** @return size rounded up to the alignment of the nodes */
+         static size_t round_up( size_t size )
+         {
+            const size_t align = alignof(std::max_align_t);
+            return ( size + align - 1 ) / align * align;
+         }
+
+      private:
+         void grow()
+         {
+            char* chunk = static_cast<char*>( ::operator new( _chunk_nodes * _node_size ) );
+            _chunks.push_back( chunk );
+            for( size_t i = _chunk_nodes; i > 0; --i )
+            {
+               void* node = chunk + ( i - 1 ) * _node_size;
+               *static_cast<void**>( node ) = _free;
+               _free = node;
+            }
+            _reserved += _chunk_nodes;
+            _chunk_nodes = std::min( _chunk_nodes * 2, size_t( max_chunk_nodes ) );
+         }
+
+         void release()
+         {
+            for( char* chunk : _chunks )
+               ::operator delete( chunk );
+            _chunks.clear();
+            _free = nullptr;
+            _reserved = 0;
+            _chunk_nodes = min_chunk_nodes;
+         }
+
+         static const size_t min_chunk_nodes = 64;
+         static const size_t max_chunk_nodes = 16384;
+
+         const size_t         _node_size;
+         void*                _free = nullptr;
+         std::vector<char*>   _chunks;
+         size_t               _chunk_nodes = min_chunk_nodes;
+         size_t               _used = 0;
+         size_t               _reserved = 0;
+   };
+
+   /** the pools of one container, shared by all rebound copies of its pool_allocator */
+   class node_pool_set
+   {
+      public:
+         node_pool& get( size_t size )
+         {
+            const size_t node_size = node_pool::round_up( std::max( size, sizeof(void*) ) );
+            for( const auto& pool : _pools )
+               if( pool->node_size() == node_size )
+                  return *pool;
+            _pools.emplace_back( new node_pool( size ) );
+            return *_pools.back();
+         }
+
+         size_t used_bytes()const
+         {
+            size_t result = 0;
+            for( const auto& pool : _pools )
+               result += pool->used_bytes();
+            return result;
+         }
+
+         size_t reserved_bytes()const
+         {
+            size_t result = 0;
+            for( const auto& pool : _pools )
+               result += pool->reserved_bytes();
+            return result;
+         }
+
+      private:
+         std::vector< std::unique_ptr<node_pool> > _pools;
+   };
+
+   /**
+    *  @class pool_allocator
+    *  @brief allocator for node based containers that takes single nodes from a node_pool
+    *
+    *  Use it as the allocator of the multi_index_container of a generic_index holding many small objects, which
+    *  saves the malloc overhead per node and makes bulk removal cheap. A default constructed allocator creates
+    *  new pools, so every container gets its own and generic_index can report its memory usage. Arrays (the
+    *  buckets of hashed indexes) come from the global heap.
+    */
+   template<typename T>
+   class pool_allocator
+   {
+      public:
+         typedef T                 value_type;
+         typedef T*                pointer;
+         typedef const T*          const_pointer;
+         typedef T&                reference;
+         typedef const T&          const_reference;
+         typedef std::size_t       size_type;
+         typedef std::ptrdiff_t    difference_type;
+
+         template<typename U>
+         struct rebind { typedef pool_allocator<U> other; };
+
+         pool_allocator() : _pools( std::make_shared<node_pool_set>() ) {}
+         template<typename U>
+         pool_allocator( const pool_allocator<U>& other ) : _pools( other._pools ) {}
+
+         T* allocate( size_t n )
+         {
+            if( n == 1 )
+               return static_cast<T*>( _pools->get( sizeof(T) ).allocate() );
+            return static_cast<T*>( ::operator new( n * sizeof(T) ) );
+         }
+
+         void deallocate( T* p, size_t n )
+         {
+            if( n == 1 )
+               _pools->get( sizeof(T) ).deallocate( p );
+            else
+               ::operator delete( p );
+         }
+
+         template<typename U, typename... Args>
+         void construct( U* p, Args&&... args ) { ::new( static_cast<void*>( p ) ) U( std::forward<Args>( args )... ); }
+         template<typename U>
+         void destroy( U* p ) { p->~U(); }
+
+         const node_pool_set& pools()const { return *_pools; }
+
+         template<typename U>
+         bool operator==( const pool_allocator<U>& other )const { return _pools == other._pools; }
+         template<typename U>
+         bool operator!=( const pool_allocator<U>& other )const { return _pools != other._pools; }
+
+      private:
+         template<typename U> friend class pool_allocator;
+         std::shared_ptr<node_pool_set> _pools;
+   };
+
+} } // graphene::db
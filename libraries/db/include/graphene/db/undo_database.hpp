@@ -23,8 +23,11 @@
  */
 #pragma once
 #include <graphene/db/object.hpp>
+#include <cstddef>
 #include <deque>
+#include <unordered_set>
 #include <fc/exception/exception.hpp>
+#include <fc/optional.hpp>
 
 namespace graphene { namespace db {
 
@@ -32,12 +35,310 @@ using std::unordered_map;
 using fc::flat_set;
 class object_database;
 
+/**
+ *  @class undo_arena
+ *  @brief bump allocator that owns all memory of one undo_state
+ *
+ *  Memory is handed out from large blocks and is never freed individually, all blocks are released at once
+ *  when the undo_state is committed, undone or discarded.
+ */
+class undo_arena
+{
+public:
+   undo_arena() = default;
+   undo_arena( const undo_arena& ) = delete;
+   undo_arena& operator=( const undo_arena& ) = delete;
+   ~undo_arena();
+
+   void* allocate( size_t size )
+   {
+      size = ( size + alignment - 1 ) & ~( alignment - 1 );
+      if( size > size_t( _end - _pos ) )
+         return allocate_block( size );
+      void* result = _pos;
+      _pos += size;
+      return result;
+   }
+
+   /** takes over all blocks of other, memory allocated from other stays valid */
+   void adopt( undo_arena& other );
+
+   /** @return the number of bytes reserved from the system */
+   size_t capacity()const { return _capacity; }
+
+private:
+   static const size_t alignment  = alignof(std::max_align_t);
+   static const size_t block_size = 64 * 1024;
+
+   void* allocate_block( size_t size );
+
+   std::vector<char*> _blocks;
+   char*              _pos = nullptr;
+   char*              _end = nullptr;
+   size_t             _capacity = 0;
+};
+
+/** standard allocator interface to an undo_arena, deallocation is a no-op */
+template<typename T>
+class undo_allocator
+{
+public:
+   typedef T value_type;
+
+   explicit undo_allocator( undo_arena* arena ) : _arena( arena ) {}
+   template<typename U>
+   undo_allocator( const undo_allocator<U>& other ) : _arena( other._arena ) {}
+
+   T*   allocate( size_t n )     { return static_cast<T*>( _arena->allocate( n * sizeof(T) ) ); }
+   void deallocate( T*, size_t ) {}
+
+   template<typename U>
+   bool operator == ( const undo_allocator<U>& other )const { return _arena == other._arena; }
+   template<typename U>
+   bool operator != ( const undo_allocator<U>& other )const { return _arena != other._arena; }
+
+private:
+   template<typename U> friend class undo_allocator;
+   undo_arena* _arena;
+};
+
+/** destroys an object copy living in an undo_arena without freeing its memory */
+struct undo_object_deleter
+{
+   void operator()( object* obj )const { obj->~object(); }
+};
+typedef std::unique_ptr<object, undo_object_deleter> undo_object_ptr;
+
+/**
+ *  @class object_delta
+ *  @brief reversible record of a change to part of an object
+ *
+ *  Saving a full copy of an object on its first modification in an undo state costs time proportional to the
+ *  size of the object. Types with large containers can instead report field-level changes through an
+ *  undo_recorder, see object_database::modify_with_delta(). The undo state then keeps a chain of deltas for
+ *  the object instead of a copy.
+ */
+class object_delta
+{
+public:
+   virtual ~object_delta(){}
+   /** reverts the change on obj, called at most once */
+   virtual void undo( object& obj ) = 0;
+
+private:
+   friend class delta_chain;
+   object_delta* _older = nullptr;
+};
+
+/** restores the previous value of one member */
+template<typename Object, typename Member>
+class member_delta : public object_delta
+{
+public:
+   member_delta( Member Object::* field, Member&& old_value )
+   :_field( field ), _old_value( std::move( old_value ) ) {}
+
+   virtual void undo( object& obj ) override
+   {
+      static_cast<Object&>( obj ).*_field = std::move( _old_value );
+   }
+
+private:
+   Member Object::*  _field;
+   Member            _old_value;
+};
+
+/** restores the previous state of one entry of a map member, erasing it if it did not exist */
+template<typename Object, typename Map>
+class map_entry_delta : public object_delta
+{
+public:
+   typedef typename Map::key_type    key_type;
+   typedef typename Map::mapped_type mapped_type;
+
+   map_entry_delta( Map Object::* field, const key_type& key, fc::optional<mapped_type>&& old_value )
+   :_field( field ), _key( key ), _old_value( std::move( old_value ) ) {}
+
+   virtual void undo( object& obj ) override
+   {
+      Map& m = static_cast<Object&>( obj ).*_field;
+      if( _old_value.valid() )
+         m[_key] = std::move( *_old_value );
+      else
+         m.erase( _key );
+   }
+
+private:
+   Map Object::*              _field;
+   key_type                   _key;
+   fc::optional<mapped_type>  _old_value;
+};
+
+/** reverts an insertion, an erasure or a change of one element of a vector member */
+template<typename Object, typename Vector>
+class vector_element_delta : public object_delta
+{
+public:
+   typedef typename Vector::value_type value_type;
+   enum change_type { inserted, erased, changed };
+
+   vector_element_delta( Vector Object::* field, size_t index, change_type change, fc::optional<value_type>&& old_value )
+   :_field( field ), _index( index ), _change( change ), _old_value( std::move( old_value ) ) {}
+
+   virtual void undo( object& obj ) override
+   {
+      Vector& v = static_cast<Object&>( obj ).*_field;
+      switch( _change )
+      {
+         case inserted:
+            v.erase( v.begin() + _index );
+            break;
+         case erased:
+            v.insert( v.begin() + _index, std::move( *_old_value ) );
+            break;
+         case changed:
+            v[_index] = std::move( *_old_value );
+            break;
+      }
+   }
+
+private:
+   Vector Object::*           _field;
+   size_t                     _index;
+   change_type                _change;
+   fc::optional<value_type>   _old_value;
+};
+
+/**
+ *  @class delta_chain
+ *  @brief the deltas recorded for one object in an undo_state, newest first
+ *
+ *  The deltas live in the arena of an undo_state, the chain only runs their destructors.
+ */
+class delta_chain
+{
+public:
+   delta_chain() = default;
+   delta_chain( const delta_chain& ) = delete;
+   delta_chain& operator=( const delta_chain& ) = delete;
+   delta_chain( delta_chain&& other ) : _newest( other._newest ), _oldest( other._oldest )
+   {
+      other._newest = other._oldest = nullptr;
+   }
+   ~delta_chain()
+   {
+      for( object_delta* d = _newest; d != nullptr; )
+      {
+         object_delta* older = d->_older;
+         d->~object_delta();
+         d = older;
+      }
+   }
+
+   void push( object_delta* delta )
+   {
+      delta->_older = _newest;
+      _newest = delta;
+      if( _oldest == nullptr )
+         _oldest = delta;
+   }
+
+   /** moves all deltas of newer, which were recorded after the deltas of this chain, into this chain */
+   void append( delta_chain&& newer )
+   {
+      if( newer._newest == nullptr )
+         return;
+      newer._oldest->_older = _newest;
+      _newest = newer._newest;
+      if( _oldest == nullptr )
+         _oldest = newer._oldest;
+      newer._newest = newer._oldest = nullptr;
+   }
+
+   /** reverts all recorded changes on obj, newest first */
+   void undo( object& obj )
+   {
+      for( object_delta* d = _newest; d != nullptr; d = d->_older )
+         d->undo( obj );
+   }
+
+private:
+   object_delta* _newest = nullptr;
+   object_delta* _oldest = nullptr;
+};
+
+/**
+ *  The containers and the saved object copies of an undo_state are allocated from its arena. The arena is
+ *  heap allocated so that the state can be moved around without invalidating the containers' allocators.
+ */
 struct undo_state
 {
-   unordered_map<object_id_type, unique_ptr<object> > old_values;
-   unordered_map<object_id_type, object_id_type>      old_index_next_ids;
-   std::unordered_set<object_id_type>                 new_ids;
-   unordered_map<object_id_type, unique_ptr<object> > removed;
+   template<typename Key, typename Value>
+   using undo_map = unordered_map< Key, Value, std::hash<Key>, std::equal_to<Key>,
+                                   undo_allocator< std::pair<const Key, Value> > >;
+   typedef std::unordered_set< object_id_type, std::hash<object_id_type>, std::equal_to<object_id_type>,
+                               undo_allocator<object_id_type> > undo_set;
+
+   undo_state()
+   :arena( new undo_arena ),
+    old_values( undo_allocator<object>( arena.get() ) ),
+    old_index_next_ids( undo_allocator<object>( arena.get() ) ),
+    new_ids( undo_allocator<object>( arena.get() ) ),
+    removed( undo_allocator<object>( arena.get() ) ),
+    old_deltas( undo_allocator<object>( arena.get() ) )
+   {}
+
+   /** @return a copy of obj allocated from this state's arena */
+   undo_object_ptr clone( const object& obj )
+   {
+      return undo_object_ptr( obj.clone_into( arena->allocate( obj.storage_size() ) ) );
+   }
+
+   // must be declared (and thus constructed) first and destroyed last
+   std::unique_ptr<undo_arena>                    arena;
+   undo_map<object_id_type, undo_object_ptr>      old_values;
+   undo_map<object_id_type, object_id_type>       old_index_next_ids;
+   undo_set                                       new_ids;
+   undo_map<object_id_type, undo_object_ptr>      removed;
+   /** objects modified through object_database::modify_with_delta(), never in any of the containers above */
+   undo_map<object_id_type, delta_chain>          old_deltas;
+};
+
+/**
+ *  @class prior_state
+ *  @brief copies of what the changes of an undo_state replaced
+ *
+ *  Captured by undo_database::copy_prior_state() from the newest undo state, e.g. a nested session, before it is
+ *  merged into the one below. Its changes can then still be told apart from those of the merged state.
+ */
+struct prior_state
+{
+   vector<unique_ptr<object>>                      objects;   ///< previous values of objects that existed before
+   flat_set<object_id_type>                        created;   ///< objects that did not exist before
+   vector<std::pair<object_id_type,object_id_type>> next_ids;  ///< index id and its next object id before
+   size_t                                          bytes = 0; ///< memory used by the object copies
+};
+
+/**
+ *  @class redo_state
+ *  @brief the values the objects of an undo_state had before it was undone
+ *
+ *  Captured by undo_database::make_redo_state() from the newest undo state. Once that state has been undone,
+ *  undo_database::redo() restores the changes without re-evaluating whatever produced them.
+ */
+struct redo_state
+{
+   vector<unique_ptr<object>>                      modified;  ///< new values of objects that existed before
+   vector<unique_ptr<object>>                      created;   ///< objects created, ordered by id
+   vector<object_id_type>                          removed;   ///< objects that existed before and were removed
+   vector<std::pair<object_id_type,object_id_type>> next_ids;  ///< index id and its next object id afterwards
+   size_t                                          bytes = 0; ///< memory used by the object copies
+
+   /**
+    *  Leaves out the changes recorded in @p later, which must have been the last ones made in the undone state,
+    *  so that redo() stops where they started. The object copies of @p later are moved into this state.
+    */
+   void rewind( prior_state& later );
 };
 
 
@@ -109,6 +410,26 @@ public:
     */
    void on_remove( const object& obj );
 
+   /**
+    * This should be called just before obj is modified through object_database::modify_with_delta()
+    *
+    * @return true if the changes must be recorded with record_delta(), in that case the following on_modify()
+    * for obj does not save a copy of it. If a copy of obj has already been saved in this undo state or the
+    * object is new, no deltas are needed.
+    */
+   bool begin_delta( const object& obj );
+
+   /**
+    * Saves a Delta constructed from args for obj in the current undo state, must only be called after
+    * begin_delta( obj ) returned true.
+    */
+   template<typename Delta, typename... Args>
+   void record_delta( const object& obj, Args&&... args )
+   {
+      auto& state = _stack.back();
+      state.old_deltas[obj.id].push( new ( state.arena->allocate( sizeof(Delta) ) ) Delta( std::forward<Args>(args)... ) );
+   }
+
    /**
     *  Removes the last committed session,
     *  note... this is dangerous if there are
@@ -117,6 +438,26 @@ public:
     */
    void pop_commit();
 
+   /**
+    *  Drops all committed sessions, they can no longer be undone. Used when
+    *  applying blocks that are known to be irreversible.
+    */
+   void clear_history();
+
+   /** @return the current values of everything the newest undo state would revert */
+   std::shared_ptr<redo_state> make_redo_state()const;
+   /**
+    *  @return copies of the values the newest undo state would restore, nullptr if some of its changes were
+    *  recorded as deltas, which cannot be copied
+    */
+   std::shared_ptr<prior_state> copy_prior_state()const;
+   /**
+    *  Re-applies the changes captured by make_redo_state() after their undo state was undone. Must be called
+    *  in an undo session on top of the same state the undone one started from. The object copies are moved
+    *  into the database, so a redo_state can be used only once.
+    */
+   void redo( redo_state& state );
+
    std::size_t size()const { return _stack.size(); }
    void set_max_size(size_t new_max_size) { _max_size = new_max_size; }
    size_t max_size()const { return _max_size; }
@@ -134,6 +475,86 @@ private:
    std::deque<undo_state>  _stack;
    object_database&        _db;
    size_t                  _max_size = 256;
+   /** object about to be modified with deltas, see begin_delta() */
+   fc::optional<object_id_type> _delta_id;
+};
+
+/**
+ *  @class undo_recorder
+ *  @brief reports field-level changes of an object to the undo_database
+ *
+ *  Passed to the modifier of object_database::modify_with_delta(). Every change must be reported before it is
+ *  made. If no deltas are needed the recorder does nothing except for the move in take().
+ */
+template<typename Object>
+class undo_recorder
+{
+public:
+   undo_recorder( undo_database& db, Object& obj, bool active )
+   :_db( db ), _obj( obj ), _active( active ) {}
+
+   /** saves a copy of a member before it is changed */
+   template<typename Member>
+   void save( Member Object::* field )
+   {
+      if( _active )
+         _db.record_delta< member_delta<Object, Member> >( _obj, field, Member( _obj.*field ) );
+   }
+
+   /** moves a member into the undo state before it is replaced or cleared, leaving it moved-from */
+   template<typename Member>
+   void take( Member Object::* field )
+   {
+      Member old_value( std::move( _obj.*field ) );
+      if( _active )
+         _db.record_delta< member_delta<Object, Member> >( _obj, field, std::move( old_value ) );
+   }
+
+   /** saves one entry of a map member before it is inserted, changed or erased */
+   template<typename Map>
+   void save_entry( Map Object::* field, const typename Map::key_type& key )
+   {
+      if( !_active )
+         return;
+      const Map& m = _obj.*field;
+      auto itr = m.find( key );
+      fc::optional<typename Map::mapped_type> old_value;
+      if( itr != m.end() )
+         old_value = itr->second;
+      _db.record_delta< map_entry_delta<Object, Map> >( _obj, field, key, std::move( old_value ) );
+   }
+
+   /** saves one element of a vector member before it is changed */
+   template<typename Vector>
+   void save_element( Vector Object::* field, size_t index )
+   {
+      if( _active )
+         _db.record_delta< vector_element_delta<Object, Vector> >( _obj, field, index,
+               vector_element_delta<Object, Vector>::changed, fc::optional<typename Vector::value_type>( ( _obj.*field )[index] ) );
+   }
+
+   /** notes that an element is about to be inserted at index into a vector member */
+   template<typename Vector>
+   void save_insert( Vector Object::* field, size_t index )
+   {
+      if( _active )
+         _db.record_delta< vector_element_delta<Object, Vector> >( _obj, field, index,
+               vector_element_delta<Object, Vector>::inserted, fc::optional<typename Vector::value_type>() );
+   }
+
+   /** saves one element of a vector member before it is erased */
+   template<typename Vector>
+   void save_erase( Vector Object::* field, size_t index )
+   {
+      if( _active )
+         _db.record_delta< vector_element_delta<Object, Vector> >( _obj, field, index,
+               vector_element_delta<Object, Vector>::erased, fc::optional<typename Vector::value_type>( ( _obj.*field )[index] ) );
+   }
+
+private:
+   undo_database& _db;
+   Object&        _obj;
+   bool           _active;
 };
 
 } } // graphene::db
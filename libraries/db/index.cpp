@@ -26,18 +26,72 @@
 #include <graphene/db/object_database.hpp>
 
 namespace graphene { namespace db {
+   fc::sha256 verify_index_file( const fc::path& file )
+   {
+      const uint64_t size = fc::file_size( file );
+      FC_ASSERT( size >= sizeof(uint64_t), "${f} is truncated", ("f",file) );
+      fc::file_mapping fm( file.generic_string().c_str(), fc::read_only );
+      fc::mapped_region mr( fm, fc::read_only, 0, size );
+      const char* data = (const char*)mr.get_address();
+
+      uint64_t magic = 0;
+      memcpy( &magic, data, sizeof(magic) );
+      const uint64_t content_size = ( magic == index_file_magic ) ? size - sizeof(fc::sha256) : size;
+      FC_ASSERT( magic != index_file_magic || size >= fc::raw::pack_size( index_file_header() ) + sizeof(fc::sha256),
+                 "${f} is truncated", ("f",file) );
+
+      // sha256::encoder takes 32 bit lengths
+      const uint64_t chunk = 1 << 30;
+      fc::sha256::encoder enc;
+      for( uint64_t pos = 0; pos < content_size; pos += chunk )
+         enc.write( data + pos, std::min( chunk, content_size - pos ) );
+      const auto hash = enc.result();
+
+      if( magic == index_file_magic )
+         FC_ASSERT( memcmp( hash.data(), data + content_size, sizeof(fc::sha256) ) == 0,
+                    "Hash mismatch, ${f} is corrupted", ("f",file) );
+      return hash;
+   }
+
    void base_primary_index::save_undo( const object& obj )
-   { _db.save_undo( obj ); }
+   {
+      _db.save_undo( obj );
+      if( _db.tracking_fingerprint() )
+         _fingerprint -= obj.hash();
+   }
 
    void base_primary_index::on_add( const object& obj )
    {
       _db.save_undo_add( obj );
+      if( _db.tracking_changes() )
+      {
+         _removed_ids.erase( obj.id );
+         _changed_ids.insert( obj.id );
+      }
+      if( _db.tracking_fingerprint() )
+         _fingerprint += obj.hash();
       for( auto ob : _observers ) ob->on_add( obj );
    }
 
    void base_primary_index::on_remove( const object& obj )
-   { _db.save_undo_remove( obj ); for( auto ob : _observers ) ob->on_remove( obj ); }
+   {
+      _db.save_undo_remove( obj );
+      if( _db.tracking_changes() )
+      {
+         _changed_ids.erase( obj.id );
+         _removed_ids.insert( obj.id );
+      }
+      if( _db.tracking_fingerprint() )
+         _fingerprint -= obj.hash();
+      for( auto ob : _observers ) ob->on_remove( obj );
+   }
 
    void base_primary_index::on_modify( const object& obj )
-   {for( auto ob : _observers ) ob->on_modify(  obj ); }
+   {
+      if( _db.tracking_changes() )
+         _changed_ids.insert( obj.id );
+      if( _db.tracking_fingerprint() )
+         _fingerprint += obj.hash();
+      for( auto ob : _observers ) ob->on_modify(  obj );
+   }
 } } // graphene::db
@@ -24,15 +24,20 @@
 #include <graphene/db/object_database.hpp>
 
 #include <fc/io/raw.hpp>
+#include <fc/io/fstream.hpp>
 #include <fc/container/flat.hpp>
+#include <fc/interprocess/file_mapping.hpp>
 #include <fc/thread/parallel.hpp>
 
+#include <fstream>
+
 namespace graphene { namespace db {
 
 object_database::object_database()
 :_undo_db(*this)
 {
    _index.resize(255);
+   _primary_index.resize(255);
    _undo_db.enable();
 }
 
@@ -68,11 +73,68 @@ index& object_database::get_mutable_index(uint8_t space_id, uint8_t type_id)
    return *idx;
 }
 
+namespace {
+   fc::path index_file( uint32_t space, uint32_t type )
+   {
+      return fc::path( fc::to_string(space) ) / fc::to_string(type);
+   }
+
+   fc::path delta_file( uint32_t space, uint32_t type, uint32_t generation )
+   {
+      return fc::path( fc::to_string(space) ) / ( fc::to_string(type) + ".delta." + fc::to_string(generation) );
+   }
+
+   void verify_checksum( const fc::path& dir, const fc::path& file, const fc::optional<snapshot_manifest>& manifest )
+   {
+      const auto checksum = verify_index_file( dir / file );
+      if( !manifest.valid() )
+         return;
+      auto itr = manifest->checksums.find( file.generic_string() );
+      FC_ASSERT( itr != manifest->checksums.end(), "No checksum for ${f}", ("f",file) );
+      FC_ASSERT( checksum == itr->second, "Checksum mismatch in ${f}", ("f",file) );
+   }
+
+   fc::sha256 fingerprint_digest( const flat_map<std::string, fc::uint128_t>& indexes )
+   {
+      fc::sha256::encoder enc;
+      for( const auto& item : indexes )
+      {
+         fc::raw::pack( enc, item.first );
+         fc::raw::pack( enc, fc::uint128_hi64( item.second ) );
+         fc::raw::pack( enc, fc::uint128_lo64( item.second ) );
+      }
+      return enc.result();
+   }
+
+   /**
+    * Waits until every task has finished, also when some of them failed. The tasks reference the state of the
+    * caller, so it must not return (or throw) while any of them is still running. Waiting on a task again
+    * afterwards returns its result or rethrows its exception.
+    */
+   template<typename T>
+   void wait_for_all( std::vector<fc::future<T>>& tasks )
+   {
+      for( auto& task : tasks )
+      {
+         try { task.wait(); }
+         catch( ... ) {}
+      }
+   }
+}
+
 void object_database::flush()
 {
+   if( _track_changes && _manifest.generation < _compaction_interval )
+   {
+      flush_changes();
+      return;
+   }
+
    ilog("Save object_database in ${d}", ("d", _data_dir));
    fc::create_directories( _data_dir / "object_database.tmp" / "lock" );
-   std::vector<fc::future<void>> tasks;
+   std::vector<fc::path> files;
+   std::vector<fc::future<fc::sha256>> tasks;
+   files.reserve(200);
    tasks.reserve(200);
    for( uint32_t space = 0; space < _index.size(); ++space )
    {
@@ -82,19 +144,87 @@ void object_database::flush()
       {
          if (_index[space][type])
          {
+            files.push_back( index_file( space, type ) );
             tasks.push_back( fc::do_parallel( [this,space,type] () {
-            _index[space][type]->save(_data_dir / "object_database.tmp" / fc::to_string(space) / fc::to_string(type));
+            return _index[space][type]->save( _data_dir / "object_database.tmp" / index_file( space, type ) );
             } ) );
          }
       }
    }
-   for( auto& task : tasks )
-      task.wait();
+   wait_for_all( tasks );
+   snapshot_manifest manifest;
+   for( size_t i = 0; i < tasks.size(); ++i )
+      manifest.checksums[ files[i].generic_string() ] = tasks[i].wait();
+   write_manifest( _data_dir / "object_database.tmp", manifest );
    fc::remove_all( _data_dir / "object_database.tmp" / "lock" );
    if( fc::exists( _data_dir / "object_database" ) )
       fc::rename( _data_dir / "object_database", _data_dir / "object_database.old" );
    fc::rename( _data_dir / "object_database.tmp", _data_dir / "object_database" );
    fc::remove_all( _data_dir / "object_database.old" );
+
+   _manifest = std::move( manifest );
+   start_tracking_changes();
+}
+
+/**
+ *  Writes one delta file per changed index next to the existing snapshot. The new files only become part
+ *  of the snapshot once the manifest referencing them has been replaced, so an interrupted flush leaves
+ *  the previous snapshot intact.
+ */
+void object_database::flush_changes()
+{
+   const uint32_t generation = _manifest.generation + 1;
+   ilog("Save object_database changes (generation ${g}) in ${d}", ("g", generation)("d", _data_dir));
+   std::vector<fc::path> files;
+   std::vector<fc::future<fc::sha256>> tasks;
+   for( uint32_t space = 0; space < _index.size(); ++space )
+   {
+      const auto types = _index[space].size();
+      for( uint32_t type = 0; type  <  types; ++type )
+      {
+         if( _index[space][type] && _index[space][type]->has_changes() )
+         {
+            fc::create_directories( _data_dir / "object_database" / fc::to_string(space) );
+            files.push_back( delta_file( space, type, generation ) );
+            tasks.push_back( fc::do_parallel( [this,space,type,generation] () {
+            return _index[space][type]->save_changes( _data_dir / "object_database" / delta_file( space, type, generation ) );
+            } ) );
+         }
+      }
+   }
+   wait_for_all( tasks );
+   snapshot_manifest manifest = _manifest;
+   manifest.generation = generation;
+   for( size_t i = 0; i < tasks.size(); ++i )
+      manifest.checksums[ files[i].generic_string() ] = tasks[i].wait();
+   write_manifest( _data_dir / "object_database", manifest );
+
+   _manifest = std::move( manifest );
+   start_tracking_changes();
+   ilog( "Saved ${n} changed indexes", ("n", files.size()) );
+}
+
+void object_database::start_tracking_changes()
+{
+   for( auto& space : _index )
+      for( auto& idx : space )
+         if( idx )
+            idx->clear_changes();
+   _track_changes = _compaction_interval > 0;
+}
+
+void object_database::write_manifest( const fc::path& dir, const snapshot_manifest& manifest )const
+{
+   const auto packed = fc::raw::pack( manifest );
+   {
+      std::ofstream out( (dir / "manifest.tmp").generic_string(),
+                         std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+      FC_ASSERT( out );
+      out.write( packed.data(), packed.size() );
+      out.close();
+      FC_ASSERT( out, "Unable to write object_database manifest" );
+   }
+   fc::rename( dir / "manifest.tmp", dir / "manifest" );
 }
 
 void object_database::wipe(const fc::path& data_dir)
@@ -102,34 +232,167 @@ void object_database::wipe(const fc::path& data_dir)
    close();
    ilog("Wiping object database...");
    fc::remove_all(data_dir / "object_database");
+   _manifest = snapshot_manifest();
+   _track_changes = false;
    ilog("Done wiping object database.");
 }
 
+fc::optional<snapshot_manifest> object_database::read_manifest( const fc::path& dir )const
+{
+   fc::optional<snapshot_manifest> manifest;
+   if( fc::exists( dir / "manifest" ) )
+   {
+      std::string packed;
+      fc::read_file_contents( dir / "manifest", packed );
+      manifest = fc::raw::unpack<snapshot_manifest>( packed.data(), packed.size() );
+   }
+   return manifest;
+}
+
+std::vector<fc::path> object_database::snapshot_files( const fc::path& dir, uint32_t space, uint32_t type,
+                                                       const fc::optional<snapshot_manifest>& manifest )const
+{
+   std::vector<fc::path> files;
+   const auto file = index_file( space, type );
+   if( !fc::exists( dir / file ) && !( manifest.valid() && manifest->checksums.count( file.generic_string() ) ) )
+      return files;
+   files.push_back( file );
+   if( !manifest.valid() )
+      return files;
+   for( uint32_t generation = 1; generation <= manifest->generation; ++generation )
+   {
+      const auto delta = delta_file( space, type, generation );
+      if( manifest->checksums.count( delta.generic_string() ) )
+         files.push_back( delta );
+   }
+   return files;
+}
+
+void object_database::verify_snapshot( const fc::path& dir, const fc::optional<snapshot_manifest>& manifest )const
+{
+   const auto start = fc::time_point::now();
+   std::vector<fc::future<void>> tasks;
+   tasks.reserve(200);
+   for( uint32_t space = 0; space < _index.size(); ++space )
+      for( uint32_t type = 0; type  < _index[space].size(); ++type )
+         if( _index[space][type] ) {
+            tasks.push_back( fc::do_parallel( [this,space,type,&dir,&manifest] () {
+            for( const auto& file : snapshot_files( dir, space, type, manifest ) )
+               verify_checksum( dir, file, manifest );
+            }));
+         }
+   wait_for_all( tasks );
+   for( auto& task : tasks )
+      task.wait();
+   ilog( "Verified object database in ${ms} ms", ("ms", (fc::time_point::now() - start).count() / 1000) );
+}
+
+void object_database::verify( const fc::path& data_dir )const
+{ try {
+   const auto dir = data_dir / "object_database";
+   verify_snapshot( dir, read_manifest( dir ) );
+} FC_CAPTURE_AND_RETHROW( (data_dir) ) }
+
 void object_database::open(const fc::path& data_dir)
 { try {
    _data_dir = data_dir;
+   _manifest = snapshot_manifest();
+   _track_changes = false;
    if( fc::exists( _data_dir / "object_database" / "lock" ) )
    {
        wlog("Ignoring locked object_database");
        return;
    }
+   const auto dir = _data_dir / "object_database";
+   const auto manifest = read_manifest( dir );
+   ilog("Opening object database from ${d} (WAIT until the process is finished) ...", ("d", data_dir));
+   // checking the hashes first is fast and avoids loading most of a snapshot that turns out to be unusable
+   verify_snapshot( dir, manifest );
+
    std::vector<fc::future<void>> tasks;
    tasks.reserve(200);
-   ilog("Opening object database from ${d} (WAIT until the process is finished) ...", ("d", data_dir));
    for( uint32_t space = 0; space < _index.size(); ++space )
       for( uint32_t type = 0; type  < _index[space].size(); ++type )
          if( _index[space][type] ) {
-            tasks.push_back( fc::do_parallel( [this,space,type] () {
-            _index[space][type]->open(_data_dir / "object_database" / fc::to_string(space) / fc::to_string(type));
+            tasks.push_back( fc::do_parallel( [this,space,type,&dir,&manifest] () {
+            const auto files = snapshot_files( dir, space, type, manifest );
+            for( size_t i = 0; i < files.size(); ++i )
+            {
+               if( i == 0 )
+                  _index[space][type]->open( dir / files[i] );
+               else
+                  _index[space][type]->open_changes( dir / files[i] );
+            }
             }));
          }
+   wait_for_all( tasks );
    for( auto& task : tasks )
-   task.wait();
+      task.wait();
+   if( manifest.valid() )
+   {
+      _manifest = *manifest;
+      start_tracking_changes();
+   }
+   // loading bypasses the hooks that maintain the fingerprint
+   if( _track_fingerprint )
+      enable_state_fingerprint();
    ilog( "Done opening object database." );
 
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
 
+void object_database::hash_indexes( const std::function<void(uint32_t,uint32_t,fc::uint128_t)>& handler )const
+{
+   std::vector<std::pair<uint32_t,uint32_t>> ids;
+   std::vector<fc::future<fc::uint128_t>> tasks;
+   ids.reserve(200);
+   tasks.reserve(200);
+   for( uint32_t space = 0; space < _index.size(); ++space )
+      for( uint32_t type = 0; type  < _index[space].size(); ++type )
+         if( _index[space][type] ) {
+            ids.emplace_back( space, type );
+            tasks.push_back( fc::do_parallel( [this,space,type] () {
+               return _index[space][type]->hash();
+            }));
+         }
+   wait_for_all( tasks );
+   for( size_t i = 0; i < tasks.size(); ++i )
+      handler( ids[i].first, ids[i].second, tasks[i].wait() );
+}
+
+state_fingerprint object_database::compute_state_fingerprint()const
+{
+   state_fingerprint result;
+   hash_indexes( [&result]( uint32_t space, uint32_t type, fc::uint128_t hash ) {
+      result.indexes[ fc::to_string(space) + "." + fc::to_string(type) ] = hash;
+   });
+   result.digest = fingerprint_digest( result.indexes );
+   return result;
+}
+
+void object_database::enable_state_fingerprint()
+{
+   const auto start = fc::time_point::now();
+   hash_indexes( [this]( uint32_t space, uint32_t type, fc::uint128_t hash ) {
+      _primary_index[space][type]->set_fingerprint( hash );
+   });
+   _track_fingerprint = true;
+   ilog( "Computed state fingerprint in ${t} ms", ("t",(fc::time_point::now() - start).count() / 1000) );
+}
+
+state_fingerprint object_database::get_state_fingerprint()const
+{
+   if( !_track_fingerprint )
+      return compute_state_fingerprint();
+   state_fingerprint result;
+   for( uint32_t space = 0; space < _primary_index.size(); ++space )
+      for( uint32_t type = 0; type  < _primary_index[space].size(); ++type )
+         if( _primary_index[space][type] )
+            result.indexes[ fc::to_string(space) + "." + fc::to_string(type) ] = _primary_index[space][type]->fingerprint();
+   result.digest = fingerprint_digest( result.indexes );
+   return result;
+}
+
 void object_database::pop_undo()
 { try {
    _undo_db.pop_commit();
@@ -150,4 +413,14 @@ void object_database::save_undo_remove(const object& obj)
    _undo_db.on_remove( obj );
 }
 
+flat_map<std::string, index_memory_stats> object_database::get_memory_stats()const
+{
+   flat_map<std::string, index_memory_stats> result;
+   for( uint32_t space = 0; space < _index.size(); ++space )
+      for( uint32_t type = 0; type  < _index[space].size(); ++type )
+         if( _index[space][type] )
+            result[ fc::to_string(space) + "." + fc::to_string(type) ] = _index[space][type]->memory_stats();
+   return result;
+}
+
 } } // namespace graphene::db
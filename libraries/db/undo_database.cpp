@@ -25,8 +25,39 @@
 #include <graphene/db/undo_database.hpp>
 #include <fc/reflect/variant.hpp>
 
+#include <algorithm>
+
 namespace graphene { namespace db {
 
+undo_arena::~undo_arena()
+{
+   for( char* block : _blocks )
+      ::operator delete( block );
+}
+
+void* undo_arena::allocate_block( size_t size )
+{
+   const size_t new_size = std::max( size, size_t( block_size ) );
+   char* block = static_cast<char*>( ::operator new( new_size ) );
+   _blocks.push_back( block );
+   _capacity += new_size;
+   // keep using the current block for small allocations if an oversized one was requested
+   if( new_size > block_size && size_t( _end - _pos ) > 0 )
+      return block;
+   _pos = block + size;
+   _end = block + new_size;
+   return block;
+}
+
+void undo_arena::adopt( undo_arena& other )
+{
+   _blocks.insert( _blocks.end(), other._blocks.begin(), other._blocks.end() );
+   _capacity += other._capacity;
+   other._blocks.clear();
+   other._pos = other._end = nullptr;
+   other._capacity = 0;
+}
+
 void undo_database::enable()  { _disabled = false; }
 void undo_database::disable() { _disabled = true; }
 
@@ -79,11 +110,41 @@ void undo_database::on_modify( const object& obj )
    if( _stack.empty() )
       _stack.emplace_back();
    auto& state = _stack.back();
+   if( _delta_id.valid() && *_delta_id == obj.id )
+   {
+      // the changes are recorded as deltas by object_database::modify_with_delta
+      _delta_id.reset();
+      return;
+   }
    if( state.new_ids.find(obj.id) != state.new_ids.end() )
       return;
    auto itr =  state.old_values.find(obj.id);
    if( itr != state.old_values.end() ) return;
-   state.old_values[obj.id] = obj.clone();
+   auto ditr = state.old_deltas.find(obj.id);
+   if( ditr != state.old_deltas.end() )
+   {
+      // a plain modification after deltas were recorded, reconstruct the original value
+      auto copy = state.clone( obj );
+      ditr->second.undo( *copy );
+      state.old_values.emplace( obj.id, std::move(copy) );
+      state.old_deltas.erase( ditr );
+      return;
+   }
+   state.old_values.emplace( obj.id, state.clone( obj ) );
+}
+bool undo_database::begin_delta( const object& obj )
+{
+   if( _disabled ) return false;
+
+   if( _stack.empty() )
+      _stack.emplace_back();
+   auto& state = _stack.back();
+   if( state.new_ids.find(obj.id) != state.new_ids.end() )
+      return false;
+   if( state.old_values.find(obj.id) != state.old_values.end() )
+      return false;
+   _delta_id = obj.id;
+   return true;
 }
 void undo_database::on_remove( const object& obj )
 {
@@ -103,8 +164,17 @@ void undo_database::on_remove( const object& obj )
       state.old_values.erase(obj.id);
       return;
    }
+   auto ditr = state.old_deltas.find(obj.id);
+   if( ditr != state.old_deltas.end() )
+   {
+      auto copy = state.clone( obj );
+      ditr->second.undo( *copy );
+      state.removed.emplace( obj.id, std::move(copy) );
+      state.old_deltas.erase( ditr );
+      return;
+   }
    if( state.removed.count(obj.id) ) return;
-   state.removed[obj.id] = obj.clone();
+   state.removed.emplace( obj.id, state.clone( obj ) );
 }
 
 void undo_database::undo()
@@ -119,6 +189,11 @@ void undo_database::undo()
          _db.modify( _db.get_object( item.second->id ), [&]( object& obj ){ obj.move_from( *item.second ); } );
       }
 
+      for( auto& item : state.old_deltas )
+      {
+         _db.modify( _db.get_object( item.first ), [&]( object& obj ){ item.second.undo( obj ); } );
+      }
+
       for( auto ritr = state.new_ids.begin(); ritr != state.new_ids.end(); ++ritr  )
       {
          _db.remove( _db.get_object(*ritr) );
@@ -190,7 +265,10 @@ void undo_database::merge()
    // (a serious logic error which should never happen).
    //
 
-   // We can only be outside type A/AB (the nop path) if B is not nop, so it suffices to iterate through B's three containers.
+   // Modifications recorded as deltas (old_deltas) behave like upd, except that combining them with a saved
+   // value requires undoing the deltas on that value.
+   //
+   // We can only be outside type A/AB (the nop path) if B is not nop, so it suffices to iterate through B's containers.
 
    // *+upd
    for( auto& obj : state.old_values )
@@ -205,12 +283,40 @@ void undo_database::merge()
          // upd(was=X) + upd(was=Y) -> upd(was=X), type A
          continue;
       }
+      auto ditr = prev_state.old_deltas.find(obj.second->id);
+      if( ditr != prev_state.old_deltas.end() )
+      {
+         // upd(deltas) + upd(was=Y) -> upd(was=Y with deltas undone), type C
+         ditr->second.undo( *obj.second );
+         prev_state.old_values[obj.second->id] = std::move(obj.second);
+         prev_state.old_deltas.erase( ditr );
+         continue;
+      }
       // del+upd -> N/A
       assert( prev_state.removed.find(obj.second->id) == prev_state.removed.end() );
       // nop+upd(was=Y) -> upd(was=Y), type B
       prev_state.old_values[obj.second->id] = std::move(obj.second);
    }
 
+   // *+upd recorded as deltas, handled like *+upd above
+   for( auto& item : state.old_deltas )
+   {
+      if( prev_state.new_ids.find(item.first) != prev_state.new_ids.end() )
+      {
+         // new+upd -> new, type A
+         continue;
+      }
+      if( prev_state.old_values.find(item.first) != prev_state.old_values.end() )
+      {
+         // upd(was=X) + upd(deltas) -> upd(was=X), type A
+         continue;
+      }
+      // del+upd -> N/A
+      assert( prev_state.removed.find(item.first) == prev_state.removed.end() );
+      // nop+upd(deltas) -> upd(deltas), type B; upd(deltas A) + upd(deltas B) -> upd(deltas A then B), type C
+      prev_state.old_deltas[item.first].append( std::move(item.second) );
+   }
+
    // *+new, but we assume the N/A cases don't happen, leaving type B nop+new -> new
    for( auto id : state.new_ids )
       prev_state.new_ids.insert(id);
@@ -249,11 +355,22 @@ void undo_database::merge()
          prev_state.old_values.erase(obj.second->id);
          continue;
       }
+      auto ditr = prev_state.old_deltas.find(obj.second->id);
+      if( ditr != prev_state.old_deltas.end() )
+      {
+         // upd(deltas) + del(was=Y) -> del(was=Y with deltas undone)
+         ditr->second.undo( *obj.second );
+         prev_state.removed[obj.second->id] = std::move(obj.second);
+         prev_state.old_deltas.erase( ditr );
+         continue;
+      }
       // del + del -> N/A
       assert( prev_state.removed.find( obj.second->id ) == prev_state.removed.end() );
       // nop + del(was=Y) -> del(was=Y)
       prev_state.removed[obj.second->id] = std::move(obj.second);
    }
+   // the object copies moved into prev_state live in state's arena
+   prev_state.arena->adopt( *state.arena );
    _stack.pop_back();
    --_active_sessions;
 }
@@ -277,6 +394,11 @@ void undo_database::pop_commit()
          _db.modify( _db.get_object( item.second->id ), [&]( object& obj ){ obj.move_from( *item.second ); } );
       }
 
+      for( auto& item : state.old_deltas )
+      {
+         _db.modify( _db.get_object( item.first ), [&]( object& obj ){ item.second.undo( obj ); } );
+      }
+
       for( auto ritr = state.new_ids.begin(); ritr != state.new_ids.end(); ++ritr  )
       {
          _db.remove( _db.get_object(*ritr) );
@@ -300,6 +422,165 @@ void undo_database::pop_commit()
    }
    enable();
 }
+void undo_database::clear_history()
+{
+   FC_ASSERT( _active_sessions == 0 );
+   _stack.clear();
+}
+
+std::shared_ptr<redo_state> undo_database::make_redo_state()const
+{
+   FC_ASSERT( !_stack.empty() );
+   const auto& state = _stack.back();
+   auto result = std::make_shared<redo_state>();
+   auto copy = [&]( const object_id_type& id ) {
+      auto obj = _db.get_object( id ).clone();
+      result->bytes += obj->storage_size();
+      return obj;
+   };
+
+   result->modified.reserve( state.old_values.size() + state.old_deltas.size() );
+   for( const auto& item : state.old_values )
+      result->modified.push_back( copy( item.first ) );
+   for( const auto& item : state.old_deltas )
+      result->modified.push_back( copy( item.first ) );
+
+   // a direct_index only accepts new objects in ascending order
+   vector<object_id_type> new_ids( state.new_ids.begin(), state.new_ids.end() );
+   std::sort( new_ids.begin(), new_ids.end() );
+   result->created.reserve( new_ids.size() );
+   for( const auto& id : new_ids )
+      result->created.push_back( copy( id ) );
+
+   result->removed.reserve( state.removed.size() );
+   for( const auto& item : state.removed )
+      result->removed.push_back( item.first );
+
+   result->next_ids.reserve( state.old_index_next_ids.size() );
+   for( const auto& item : state.old_index_next_ids )
+      result->next_ids.emplace_back( item.first, _db.get_index( item.first.space(), item.first.type() ).get_next_id() );
+   return result;
+}
+
+std::shared_ptr<prior_state> undo_database::copy_prior_state()const
+{
+   FC_ASSERT( !_stack.empty() );
+   const auto& state = _stack.back();
+   // undoing deltas consumes them
+   if( !state.old_deltas.empty() )
+      return std::shared_ptr<prior_state>();
+
+   auto result = std::make_shared<prior_state>();
+   auto copy = [&]( const object& obj ) {
+      auto result_obj = obj.clone();
+      result->bytes += result_obj->storage_size();
+      return result_obj;
+   };
+   result->objects.reserve( state.old_values.size() + state.removed.size() );
+   for( const auto& item : state.old_values )
+      result->objects.push_back( copy( *item.second ) );
+   for( const auto& item : state.removed )
+      result->objects.push_back( copy( *item.second ) );
+   result->created.reserve( state.new_ids.size() );
+   for( const auto& id : state.new_ids )
+      result->created.insert( id );
+   result->next_ids.reserve( state.old_index_next_ids.size() );
+   for( const auto& item : state.old_index_next_ids )
+      result->next_ids.emplace_back( item.first, item.second );
+   return result;
+}
+
+void redo_state::rewind( prior_state& later )
+{
+   auto by_id = []( const unique_ptr<object>& a, const unique_ptr<object>& b ) { return a->id < b->id; };
+
+   // objects created by the later changes did not exist before them
+   created.erase( std::remove_if( created.begin(), created.end(),
+                                  [&later]( const unique_ptr<object>& obj ) { return later.created.count( obj->id ) > 0; } ),
+                  created.end() );
+
+   // objects changed by the later changes get the values they had before them
+   flat_map<object_id_type, unique_ptr<object>*> changed;
+   changed.reserve( modified.size() + created.size() );
+   for( auto& obj : modified )
+      changed.emplace( obj->id, &obj );
+   for( auto& obj : created )
+      changed.emplace( obj->id, &obj );
+   vector<unique_ptr<object>> existed;
+   vector<unique_ptr<object>> new_before;
+   for( auto& obj : later.objects )
+   {
+      auto itr = changed.find( obj->id );
+      if( itr != changed.end() )
+      {
+         *itr->second = std::move( obj );
+         continue;
+      }
+      // removed by the later changes, it either existed before the undone state or was created in it
+      auto ritr = std::find( removed.begin(), removed.end(), obj->id );
+      if( ritr != removed.end() )
+      {
+         removed.erase( ritr );
+         existed.push_back( std::move( obj ) );
+      }
+      else
+         new_before.push_back( std::move( obj ) );
+   }
+   later.objects.clear();
+   std::move( existed.begin(), existed.end(), std::back_inserter( modified ) );
+   if( !new_before.empty() )
+   {
+      std::move( new_before.begin(), new_before.end(), std::back_inserter( created ) );
+      std::sort( created.begin(), created.end(), by_id );
+   }
+
+   for( const auto& item : later.next_ids )
+   {
+      auto itr = std::find_if( next_ids.begin(), next_ids.end(),
+                               [&item]( const std::pair<object_id_type,object_id_type>& n ) { return n.first == item.first; } );
+      if( itr != next_ids.end() )
+         itr->second = item.second;
+      else
+         next_ids.push_back( item );
+   }
+
+   bytes = 0;
+   for( const auto& obj : modified )
+      bytes += obj->storage_size();
+   for( const auto& obj : created )
+      bytes += obj->storage_size();
+}
+
+void undo_database::redo( redo_state& redo )
+{ try {
+   FC_ASSERT( !_disabled );
+   FC_ASSERT( _active_sessions > 0 );
+   auto& state = _stack.back();
+
+   // on_create() would take the id of the first created object as the old next id, which is only right
+   // if that object was created first
+   for( const auto& item : redo.next_ids )
+   {
+      if( state.old_index_next_ids.find( item.first ) == state.old_index_next_ids.end() )
+         state.old_index_next_ids[item.first] = _db.get_mutable_index( item.first.space(), item.first.type() ).get_next_id();
+   }
+
+   // removals first, the created and modified objects may reuse their unique keys
+   for( const auto& id : redo.removed )
+      _db.remove( _db.get_object( id ) );
+   for( auto& obj : redo.modified )
+      _db.modify( _db.get_object( obj->id ), [&]( object& o ){ o.move_from( *obj ); } );
+   for( auto& obj : redo.created )
+      _db.insert( std::move( *obj ) );
+   for( const auto& item : redo.next_ids )
+      _db.get_mutable_index( item.first.space(), item.first.type() ).set_next_id( item.second );
+
+   redo.modified.clear();
+   redo.created.clear();
+   redo.removed.clear();
+   redo.bytes = 0;
+} FC_CAPTURE_AND_RETHROW() }
+
 const undo_state& undo_database::head()const
 {
    FC_ASSERT( !_stack.empty() );
@@ -7,4 +7,7 @@ namespace fc
 
 std::string zlib_compress(const std::string& in);
 
+/** @throws fc::exception if @p in is not a valid zlib stream */
+std::string zlib_decompress(const std::string& in);
+
 } // namespace fc
@@ -1,4 +1,5 @@
 #include <fc/compress/zlib.hpp>
+#include <fc/exception/exception.hpp>
 
 #include "miniz.c"
 
@@ -12,4 +13,14 @@ namespace fc
     free(compressed_message);
     return result;
   }
+
+  std::string zlib_decompress(const std::string& in)
+  {
+    size_t decompressed_message_length;
+    char* decompressed_message = (char*)tinfl_decompress_mem_to_heap(in.c_str(), in.size(), &decompressed_message_length, TINFL_FLAG_PARSE_ZLIB_HEADER);
+    FC_ASSERT( decompressed_message != nullptr, "Invalid zlib stream" );
+    std::string result(decompressed_message, decompressed_message_length);
+    free(decompressed_message);
+    return result;
+  }
 }
@@ -72,13 +72,15 @@ namespace graphene { namespace net {
           *  @brief Called when a new block comes in from the network
           *
           *  @param sync_mode true if the message was fetched through the sync process, false during normal operation
+          *  @param origin endpoint of the peer that sent the block, empty if it is not known
           *  @returns true if this message caused the blockchain to switch forks, false if it did not
           *
           *  @throws exception if error validating the item, otherwise the item is
           *          safe to broadcast on.
           */
          virtual bool handle_block( const graphene::net::block_message& blk_msg, bool sync_mode, 
-                                    std::vector<fc::uint160_t>& contained_transaction_message_ids ) = 0;
+                                    std::vector<fc::uint160_t>& contained_transaction_message_ids,
+                                    const std::string& origin ) = 0;
          
          /**
           *  @brief Called when a new transaction comes in from the network
@@ -485,9 +485,9 @@ namespace graphene { namespace net { namespace detail {
     {
       VERIFY_CORRECT_THREAD();
       return std::find_if(_received_sync_items.begin(), _received_sync_items.end(),
-                          [&item_hash]( const graphene::net::block_message& message ) { return message.block_id == item_hash; } ) != _received_sync_items.end() ||
+                          [&item_hash]( const received_sync_item& item ) { return item.message.block_id == item_hash; } ) != _received_sync_items.end() ||
              std::find_if(_new_received_sync_items.begin(), _new_received_sync_items.end(),
-                          [&item_hash]( const graphene::net::block_message& message ) { return message.block_id == item_hash; } ) != _new_received_sync_items.end();                          ;
+                          [&item_hash]( const received_sync_item& item ) { return item.message.block_id == item_hash; } ) != _new_received_sync_items.end();                          ;
     }
 
     void node_impl::request_sync_item_from_peer( const peer_connection_ptr& peer, const item_hash_t& item_to_request )
@@ -2540,7 +2540,7 @@ namespace graphene { namespace net { namespace detail {
       schedule_peer_for_deletion(originating_peer_ptr);
     }
 
-    void node_impl::send_sync_block_to_node_delegate(const graphene::net::block_message& block_message_to_send)
+    void node_impl::send_sync_block_to_node_delegate(const graphene::net::block_message& block_message_to_send, const std::string& origin)
     {
       dlog("in send_sync_block_to_node_delegate()");
       bool client_accepted_block = false;
@@ -2551,7 +2551,7 @@ namespace graphene { namespace net { namespace detail {
       try
       {
         std::vector<fc::uint160_t> contained_transaction_message_ids;
-        _delegate->handle_block(block_message_to_send, true, contained_transaction_message_ids);
+        _delegate->handle_block(block_message_to_send, true, contained_transaction_message_ids, origin);
         ilog("Successfully pushed sync block ${num} (id:${id})",
              ("num", block_message_to_send.block.block_num())
              ("id", block_message_to_send.block_id));
@@ -2785,11 +2785,11 @@ namespace graphene { namespace net { namespace detail {
           {
             ASSERT_TASK_NOT_PREEMPTED(); // don't yield while iterating over _active_connections
             if (!peer->ids_of_items_to_get.empty() &&
-                peer->ids_of_items_to_get.front() == received_block_iter->block_id)
+                peer->ids_of_items_to_get.front() == received_block_iter->message.block_id)
             {
               potential_first_block = true;
               peer->ids_of_items_to_get.pop_front();
-              peer->ids_of_items_being_processed.insert(received_block_iter->block_id);
+              peer->ids_of_items_being_processed.insert(received_block_iter->message.block_id);
             }
           }
 
@@ -2803,12 +2803,12 @@ namespace graphene { namespace net { namespace detail {
             // we don't know they're the same (for the peer in normal operation, it has only told us the
             // message id, for the peer in the sync case we only known the block_id).
             if (std::find(_most_recent_blocks_accepted.begin(), _most_recent_blocks_accepted.end(),
-                          received_block_iter->block_id) == _most_recent_blocks_accepted.end())
+                          received_block_iter->message.block_id) == _most_recent_blocks_accepted.end())
             {
-              graphene::net::block_message block_message_to_process = *received_block_iter;
+              received_sync_item item_to_process = *received_block_iter;
               _received_sync_items.erase(received_block_iter);
-              _handle_message_calls_in_progress.emplace_back(fc::async([this, block_message_to_process](){
-                send_sync_block_to_node_delegate(block_message_to_process);
+              _handle_message_calls_in_progress.emplace_back(fc::async([this, item_to_process](){
+                send_sync_block_to_node_delegate(item_to_process.message, item_to_process.origin);
               }, "send_sync_block_to_node_delegate"));
               ++blocks_processed;
               block_processed_this_iteration = true;
@@ -2819,7 +2819,7 @@ namespace graphene { namespace net { namespace detail {
               std::vector< peer_connection_ptr > peers_needing_next_batch;
               for (const peer_connection_ptr& peer : _active_connections)
               {
-                auto items_being_processed_iter = peer->ids_of_items_being_processed.find(received_block_iter->block_id);
+                auto items_being_processed_iter = peer->ids_of_items_being_processed.find(received_block_iter->message.block_id);
                 if (items_being_processed_iter != peer->ids_of_items_being_processed.end())
                 {
                   peer->ids_of_items_being_processed.erase(items_being_processed_iter);
@@ -2879,7 +2879,9 @@ namespace graphene { namespace net { namespace detail {
 
       // add it to the front of _received_sync_items, then process _received_sync_items to try to
       // pass as many messages as possible to the client.
-      _new_received_sync_items.push_front( block_message_to_process );
+      const auto origin = originating_peer->get_remote_endpoint();
+      _new_received_sync_items.push_front( received_sync_item{ block_message_to_process,
+                                                               origin ? std::string( *origin ) : std::string() } );
       trigger_process_backlog_of_sync_blocks();
     }
 
@@ -2907,7 +2909,9 @@ namespace graphene { namespace net { namespace detail {
                       block_message_to_process.block_id) == _most_recent_blocks_accepted.end())
         {
           std::vector<fc::uint160_t> contained_transaction_message_ids;
-          _delegate->handle_block(block_message_to_process, false, contained_transaction_message_ids);
+          const auto origin = originating_peer->get_remote_endpoint();
+          _delegate->handle_block(block_message_to_process, false, contained_transaction_message_ids,
+                                  origin ? std::string( *origin ) : std::string());
           message_validated_time = fc::time_point::now();
           ilog("Successfully pushed block ${num} (id:${id})",
                 ("num", block_message_to_process.block.block_num())
@@ -4885,7 +4889,7 @@ namespace graphene { namespace net { namespace detail {
         else if (message_to_deliver.msg_type.value() == block_message_type)
         {
           std::vector<fc::uint160_t> contained_transaction_message_ids;
-          destination_node->delegate->handle_block(message_to_deliver.as<block_message>(), false, contained_transaction_message_ids);
+          destination_node->delegate->handle_block(message_to_deliver.as<block_message>(), false, contained_transaction_message_ids, std::string());
         }
         else
           destination_node->delegate->handle_message(message_to_deliver);
@@ -5025,9 +5029,10 @@ namespace graphene { namespace net { namespace detail {
       INVOKE_AND_COLLECT_STATISTICS(handle_message, message_to_handle);
     }
 
-    bool statistics_gathering_node_delegate_wrapper::handle_block( const graphene::net::block_message& block_message, bool sync_mode, std::vector<fc::uint160_t>& contained_transaction_message_ids)
+    bool statistics_gathering_node_delegate_wrapper::handle_block( const graphene::net::block_message& block_message, bool sync_mode, std::vector<fc::uint160_t>& contained_transaction_message_ids,
+                                                                   const std::string& origin )
     {
-      INVOKE_AND_COLLECT_STATISTICS(handle_block, block_message, sync_mode, contained_transaction_message_ids);
+      INVOKE_AND_COLLECT_STATISTICS(handle_block, block_message, sync_mode, contained_transaction_message_ids, origin);
     }
 
     void statistics_gathering_node_delegate_wrapper::handle_transaction( const graphene::net::trx_message& transaction_message )
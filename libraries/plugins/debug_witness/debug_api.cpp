@@ -29,6 +29,8 @@ class debug_api_impl
       //void debug_save_db( std::string db_path );
       void debug_stream_json_objects( const std::string& filename );
       void debug_stream_json_objects_flush();
+      graphene::db::state_fingerprint debug_get_state_fingerprint();
+      fc::flat_map<std::string, graphene::db::index_memory_stats> debug_get_index_memory_stats();
       std::shared_ptr< graphene::debug_witness_plugin::debug_witness_plugin > get_plugin();
 
       graphene::app::application& app;
@@ -120,6 +122,18 @@ void debug_api_impl::debug_stream_json_objects_flush()
    get_plugin()->flush_json_object_stream();
 }
 
+graphene::db::state_fingerprint debug_api_impl::debug_get_state_fingerprint()
+{
+   std::shared_ptr< graphene::chain::database > db = app.chain_database();
+   return db->get_state_fingerprint();
+}
+
+fc::flat_map<std::string, graphene::db::index_memory_stats> debug_api_impl::debug_get_index_memory_stats()
+{
+   std::shared_ptr< graphene::chain::database > db = app.chain_database();
+   return db->get_memory_stats();
+}
+
 } // detail
 
 debug_api::debug_api( graphene::app::application& app )
@@ -152,5 +166,15 @@ void debug_api::debug_stream_json_objects_flush()
    my->debug_stream_json_objects_flush();
 }
 
+graphene::db::state_fingerprint debug_api::debug_get_state_fingerprint()
+{
+   return my->debug_get_state_fingerprint();
+}
+
+fc::flat_map<std::string, graphene::db::index_memory_stats> debug_api::debug_get_index_memory_stats()
+{
+   return my->debug_get_index_memory_stats();
+}
+
 
 } } // graphene::debug_witness
@@ -26,6 +26,8 @@
 #include <memory>
 #include <string>
 
+#include <graphene/db/object_database.hpp>
+
 #include <fc/api.hpp>
 #include <fc/variant_object.hpp>
 
@@ -82,6 +84,16 @@ class debug_api
        */
       void debug_stream_json_objects_flush();
 
+      /**
+       * Get the fingerprint of the chain state, compare it between nodes to find the indexes in which they diverge.
+       */
+      graphene::db::state_fingerprint debug_get_state_fingerprint();
+
+      /**
+       * Get the number of objects and, for pool allocated indexes, the memory used by every index.
+       */
+      fc::flat_map<std::string, graphene::db::index_memory_stats> debug_get_index_memory_stats();
+
       std::shared_ptr< detail::debug_api_impl > my;
 };
 
@@ -93,4 +105,6 @@ FC_API(graphene::debug_witness::debug_api,
        (debug_update_object)
        (debug_stream_json_objects)
        (debug_stream_json_objects_flush)
+       (debug_get_state_fingerprint)
+       (debug_get_index_memory_stats)
      )
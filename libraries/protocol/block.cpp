@@ -23,6 +23,7 @@
  */
 #include <graphene/protocol/block.hpp>
 #include <graphene/protocol/fee_schedule.hpp>
+#include <graphene/protocol/signature_cache.hpp>
 #include <fc/io/raw.hpp>
 #include <algorithm>
 
@@ -49,7 +50,7 @@ namespace graphene { namespace protocol {
 
    fc::ecc::public_key signed_block_header::signee()const
    {
-      return fc::ecc::public_key( witness_signature, digest(), true/*enforce canonical*/ );
+      return signature_cache::instance().recover( witness_signature, digest() ); // enforces canonical signatures
    }
 
    void signed_block_header::sign( const fc::ecc::private_key& signer )
@@ -62,6 +63,17 @@ namespace graphene { namespace protocol {
       return signee() == expected_signee;
    }
 
+   size_t signed_block::packed_size()const
+   {
+      size_t size = fc::raw::pack_size( static_cast<const signed_block_header&>(*this) )
+                  + fc::raw::pack_size( fc::unsigned_int( transactions.size() ) )
+                  + fc::raw::pack_size( block_id )
+                  + fc::raw::pack_size( block_number );
+      for( const auto& trx : transactions )
+         size += trx.packed_size();
+      return size;
+   }
+
    checksum_type signed_block::calculate_merkle_root()const
    {
       if( transactions.size() == 0 ) 
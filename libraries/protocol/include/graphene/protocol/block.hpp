@@ -55,6 +55,8 @@ namespace graphene { namespace protocol {
       block_id_type block_id;
       uint32_t block_number;
       checksum_type calculate_merkle_root()const;
+      /// Same as fc::raw::pack_size(*this), reusing the packed sizes memoized on the transactions
+      size_t packed_size()const;
       vector<processed_transaction> transactions;
       void update() {
           block_id = id();
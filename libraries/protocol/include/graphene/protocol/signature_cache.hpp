@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <fc/crypto/elliptic.hpp>
+#include <fc/crypto/sha256.hpp>
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace graphene { namespace protocol {
+
+   /**
+    *  @brief Bounded LRU cache of public keys recovered from compact signatures
+    *
+    *  The same signature is usually recovered several times: when a transaction arrives from the network, when it
+    *  is validated through the API, when the block containing it is pushed, and whenever a block's signee is
+    *  checked.  Entries are keyed by (digest, signature), so a hit is always exactly what the recovery would
+    *  return.  Only successful recoveries are cached; canonical signatures are enforced as in
+    *  fc::ecc::public_key's default constructor.
+    *
+    *  The cache is thread safe.  Recovery on a miss happens outside the lock so worker threads recovering
+    *  different signatures do not serialize on it.
+    */
+   class signature_cache
+   {
+      public:
+         static const size_t default_capacity = 50000;
+
+         explicit signature_cache( size_t capacity = default_capacity );
+
+         /// The process wide cache consulted by signed_transaction and signed_block_header
+         static signature_cache& instance();
+
+         /// @return the key recovered from @p sig over @p digest, recovering and caching it on a miss
+         fc::ecc::public_key recover( const fc::ecc::compact_signature& sig, const fc::sha256& digest );
+
+         /// Changes the maximum number of entries, evicting as needed; 0 disables caching
+         void     set_capacity( size_t capacity );
+         size_t   capacity()const;
+         size_t   size()const;
+         void     clear();
+
+         uint64_t hits()const   { return _hits; }
+         uint64_t misses()const { return _misses; }
+
+      private:
+         struct entry_key
+         {
+            fc::sha256                     digest;
+            fc::ecc::compact_signature     sig;
+
+            bool operator == ( const entry_key& other )const
+            { return digest == other.digest && sig == other.sig; }
+         };
+         struct entry_key_hash
+         {
+            size_t operator()( const entry_key& k )const;
+         };
+         typedef std::list< std::pair< entry_key, fc::ecc::public_key_data > > lru_list;
+
+         void evict();
+
+         mutable std::mutex                                              _mutex;
+         size_t                                                          _capacity;
+         lru_list                                                        _lru; ///< most recently used first
+         std::unordered_map< entry_key, lru_list::iterator, entry_key_hash > _entries;
+         std::atomic<uint64_t>                                           _hits{0};
+         std::atomic<uint64_t>                                           _misses{0};
+   };
+
+} } // graphene::protocol
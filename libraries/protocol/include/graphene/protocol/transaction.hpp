@@ -84,12 +84,14 @@ namespace graphene { namespace protocol {
       vector<operation>  operations;
       extensions_type    extensions;
 
+      virtual ~transaction() = default;
+
       /// Calculate the digest for a transaction
-      digest_type         digest()const;
-      transaction_id_type id()const;
-      void                validate() const;
+      digest_type                 digest()const;
+      virtual transaction_id_type id()const;
+      void                        validate() const;
       /// Calculate the digest used for signature validation
-      digest_type         sig_digest( const chain_id_type& chain_id )const;
+      virtual digest_type         sig_digest( const chain_id_type& chain_id )const;
 
       void set_expiration( fc::time_point_sec expiration_time );
       void set_reference_block( const block_id_type& reference_block );
@@ -165,12 +167,24 @@ namespace graphene { namespace protocol {
          uint32_t max_recursion = GRAPHENE_MAX_SIG_CHECK_DEPTH
          ) const;
 
-      flat_set<public_key_type> get_signature_keys( const chain_id_type& chain_id )const;
+      /**
+       * Recovers the public keys of @ref signatures. The result is cached in @ref signees together with a
+       * hash of the signed digest and the signatures it was recovered from, so repeated calls on an unchanged
+       * transaction (e.g. when verify_authority() runs again for a pending transaction) skip the EC recovery.
+       */
+      const flat_set<public_key_type>& get_signature_keys( const chain_id_type& chain_id )const;
 
       vector<signature_type> signatures;
 
+      /// Public keys recovered from signatures, filled by get_signature_keys()
+      mutable flat_set<public_key_type> signees;
+
       /// Removes all operations and signatures
-      void clear() { operations.clear(); signatures.clear(); }
+      void clear() { operations.clear(); signatures.clear(); signees.clear(); _signees_source = digest_type(); }
+
+   private:
+      /// hash of the signed digest and the signatures @ref signees was recovered from
+      mutable digest_type _signees_source;
    };
 
    void verify_authority( const vector<operation>& ops, const flat_set<public_key_type>& sigs,
@@ -181,6 +195,31 @@ namespace graphene { namespace protocol {
                           const flat_set<account_id_type>& active_aprovals = flat_set<account_id_type>(),
                           const flat_set<account_id_type>& owner_approvals = flat_set<account_id_type>());
 
+   /**
+    *  @brief a signed transaction that memoizes the results of serializing it
+    *
+    *  Transactions that travel through push_block and push_transaction are not modified once received, yet their
+    *  id and signature digest are needed several times on the way.  Both are computed from a single serialization
+    *  the first time either is requested and returned from the cache afterwards, so a precomputable_transaction
+    *  must not be modified after that.
+    */
+   struct precomputable_transaction : public signed_transaction
+   {
+      precomputable_transaction() {}
+      precomputable_transaction( const signed_transaction& trx ) : signed_transaction( trx ) {}
+      precomputable_transaction( signed_transaction&& trx ) : signed_transaction( std::move(trx) ) {}
+
+      transaction_id_type id()const override;
+      digest_type         sig_digest( const chain_id_type& chain_id )const override;
+
+   private:
+      void precompute( const chain_id_type& chain_id )const;
+
+      mutable fc::optional<transaction_id_type> _id;
+      mutable chain_id_type                     _sig_digest_chain_id;
+      mutable fc::optional<digest_type>         _sig_digest;
+   };
+
    /**
     *  @brief captures the result of evaluating the operations contained in the transaction
     *
@@ -194,14 +233,23 @@ namespace graphene { namespace protocol {
     *  If an operation did not create any new object IDs then 0
     *  should be returned.
     */
-   struct processed_transaction : public signed_transaction
+   struct processed_transaction : public precomputable_transaction
    {
       processed_transaction( const signed_transaction& trx = signed_transaction() )
-         : signed_transaction(trx){}
+         : precomputable_transaction(trx){}
 
       vector<operation_result> operation_results;
 
+      /// Memoized once @ref operation_results is final, like the rest of the precomputed values
       digest_type merkle_digest()const;
+      /// Same as fc::raw::pack_size(*this), memoized together with merkle_digest()
+      size_t      packed_size()const;
+
+   private:
+      void precompute_packed()const;
+
+      mutable fc::optional<digest_type> _merkle_digest;
+      mutable size_t                    _packed_size = 0;
    };
 
    /// @} transactions group
@@ -211,9 +259,10 @@ namespace graphene { namespace protocol {
 FC_REFLECT( graphene::protocol::transaction, (ref_block_num)(ref_block_prefix)(expiration)(operations)(extensions) )
 // Note: not reflecting signees field for backward compatibility; in addition, it should not be in p2p messages
 FC_REFLECT_DERIVED( graphene::protocol::signed_transaction, (graphene::protocol::transaction), (signatures) )
-FC_REFLECT_DERIVED( graphene::protocol::processed_transaction, (graphene::protocol::signed_transaction), (operation_results) )
+FC_REFLECT_DERIVED( graphene::protocol::precomputable_transaction, (graphene::protocol::signed_transaction), BOOST_PP_SEQ_NIL )
+FC_REFLECT_DERIVED( graphene::protocol::processed_transaction, (graphene::protocol::precomputable_transaction), (operation_results) )
 
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::protocol::transaction)
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::protocol::signed_transaction)
-//GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::protocol::precomputable_transaction)
+GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::protocol::precomputable_transaction)
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::protocol::processed_transaction)
\ No newline at end of file
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/protocol/signature_cache.hpp>
+
+#include <cstring>
+
+namespace graphene { namespace protocol {
+
+   signature_cache::signature_cache( size_t capacity )
+      : _capacity( capacity ) {}
+
+   signature_cache& signature_cache::instance()
+   {
+      static signature_cache cache;
+      return cache;
+   }
+
+   size_t signature_cache::entry_key_hash::operator()( const entry_key& k )const
+   {
+      // both parts are already uniformly distributed
+      uint64_t d, s;
+      memcpy( &d, k.digest.data(), sizeof(d) );
+      memcpy( &s, k.sig.data() + 1, sizeof(s) );
+      return size_t( d ^ s );
+   }
+
+   fc::ecc::public_key signature_cache::recover( const fc::ecc::compact_signature& sig, const fc::sha256& digest )
+   {
+      entry_key key{ digest, sig };
+      {
+         std::lock_guard<std::mutex> lock( _mutex );
+         auto itr = _entries.find( key );
+         if( itr != _entries.end() )
+         {
+            _lru.splice( _lru.begin(), _lru, itr->second );
+            ++_hits;
+            return fc::ecc::public_key( itr->second->second );
+         }
+      }
+
+      ++_misses;
+      fc::ecc::public_key result( sig, digest );
+
+      std::lock_guard<std::mutex> lock( _mutex );
+      if( _capacity == 0 || _entries.find( key ) != _entries.end() )
+         return result;
+      _lru.emplace_front( key, result.serialize() );
+      _entries.emplace( key, _lru.begin() );
+      evict();
+      return result;
+   }
+
+   void signature_cache::evict()
+   {
+      while( _entries.size() > _capacity )
+      {
+         _entries.erase( _lru.back().first );
+         _lru.pop_back();
+      }
+   }
+
+   void signature_cache::set_capacity( size_t capacity )
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      _capacity = capacity;
+      evict();
+   }
+
+   size_t signature_cache::capacity()const
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      return _capacity;
+   }
+
+   size_t signature_cache::size()const
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      return _entries.size();
+   }
+
+   void signature_cache::clear()
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      _entries.clear();
+      _lru.clear();
+   }
+
+} } // graphene::protocol
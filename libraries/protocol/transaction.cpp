@@ -25,17 +25,32 @@
 #include <graphene/protocol/exceptions.hpp>
 #include <graphene/protocol/fee_schedule.hpp>
 #include <graphene/protocol/pts_address.hpp>
+#include <graphene/protocol/signature_cache.hpp>
 #include <algorithm>
 
 #include <fc/io/raw.hpp>
 
 namespace graphene { namespace protocol {
 
+void processed_transaction::precompute_packed()const
+{
+   const auto packed = fc::raw::pack( *this );
+   _merkle_digest = digest_type::hash( packed.data(), packed.size() );
+   _packed_size = packed.size();
+}
+
 digest_type processed_transaction::merkle_digest()const
 {
-   digest_type::encoder enc;
-   fc::raw::pack( enc, *this );
-   return enc.result();
+   if( !_merkle_digest.valid() )
+      precompute_packed();
+   return *_merkle_digest;
+}
+
+size_t processed_transaction::packed_size()const
+{
+   if( !_merkle_digest.valid() )
+      precompute_packed();
+   return _packed_size;
 }
 
 digest_type transaction::digest()const
@@ -53,6 +68,37 @@ digest_type transaction::sig_digest( const chain_id_type& chain_id )const
    return enc.result();
 }
 
+void precomputable_transaction::precompute( const chain_id_type& chain_id )const
+{
+   // both digests hash the same serialization, the signature digest prefixed with the chain id
+   const auto packed = fc::raw::pack( static_cast<const transaction&>(*this) );
+
+   const auto digest = digest_type::hash( packed.data(), packed.size() );
+   transaction_id_type id;
+   memcpy( id._hash, digest._hash, std::min( sizeof(id), sizeof(digest) ) );
+   _id = id;
+
+   digest_type::encoder enc;
+   fc::raw::pack( enc, chain_id );
+   enc.write( packed.data(), packed.size() );
+   _sig_digest = enc.result();
+   _sig_digest_chain_id = chain_id;
+}
+
+transaction_id_type precomputable_transaction::id()const
+{
+   if( !_id.valid() )
+      _id = transaction::id();
+   return *_id;
+}
+
+digest_type precomputable_transaction::sig_digest( const chain_id_type& chain_id )const
+{
+   if( !_sig_digest.valid() || _sig_digest_chain_id != chain_id )
+      precompute( chain_id );
+   return *_sig_digest;
+}
+
 void transaction::validate() const
 {
    FC_ASSERT( operations.size() > 0, "A transaction must have at least one operation", ("trx",*this) );
@@ -302,18 +348,29 @@ void verify_authority( const vector<operation>& ops, const flat_set<public_key_t
 } FC_CAPTURE_AND_RETHROW( (ops)(sigs) ) }
 
 
-flat_set<public_key_type> signed_transaction::get_signature_keys( const chain_id_type& chain_id )const
+const flat_set<public_key_type>& signed_transaction::get_signature_keys( const chain_id_type& chain_id )const
 { try {
    auto d = sig_digest( chain_id );
+
+   digest_type::encoder enc;
+   fc::raw::pack( enc, d );
+   fc::raw::pack( enc, signatures );
+   digest_type source = enc.result();
+   if( source == _signees_source )
+      return signees;
+
    flat_set<public_key_type> result;
+   result.reserve( signatures.size() );
    for( const auto&  sig : signatures )
    {
       GRAPHENE_ASSERT(
-         result.insert( fc::ecc::public_key(sig,d) ).second,
+         result.insert( signature_cache::instance().recover( sig, d ) ).second,
          tx_duplicate_sig,
          "Duplicate Signature detected" );
    }
-   return result;
+   signees = std::move( result );
+   _signees_source = source;
+   return signees;
 } FC_CAPTURE_AND_RETHROW() }
 
 
@@ -392,5 +449,5 @@ void signed_transaction::verify_authority(
 
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::protocol::transaction)
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::protocol::signed_transaction)
-//GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::protocol::precomputable_transaction)
+GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::protocol::precomputable_transaction)
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::protocol::processed_transaction)
\ No newline at end of file
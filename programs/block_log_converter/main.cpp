@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <iostream>
+
+#include <fc/filesystem.hpp>
+#include <fc/io/raw.hpp>
+
+#include <graphene/chain/block_database.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+using namespace graphene::chain;
+namespace bpo = boost::program_options;
+
+/**
+ * Copies a block database (the block_num_to_block directory of a stopped node) into a new one, either compressing
+ * the blocks in chunks or writing them back uncompressed, and verifies the copy block by block.
+ *
+ * With "--output -" the blocks are written to stdout as a stream of size prefixed packed blocks instead, the
+ * format read by "witness_node --import-blocks -".
+ */
+int main( int argc, char** argv )
+{
+   try
+   {
+      bpo::options_description cli_options("Convert a block database between plain and compressed storage");
+      cli_options.add_options()
+            ("help,h", "Print this help message and exit.")
+            ("input,i", bpo::value<boost::filesystem::path>(), "Block database directory to read, e.g. "
+                                                              "<data-dir>/blockchain/database/block_num_to_block")
+            ("output,o", bpo::value<boost::filesystem::path>(), "Block database directory to create, or \"-\" to "
+                                                               "write a block stream to stdout")
+            ("chunk-size", bpo::value<uint32_t>()->default_value(1024*1024), "Decompressed size of a chunk in bytes")
+            ("decompress", "Write the blocks uncompressed")
+            ;
+
+      bpo::variables_map options;
+      try
+      {
+         bpo::store( bpo::parse_command_line(argc, argv, cli_options), options );
+      }
+      catch (const bpo::error& e)
+      {
+         std::cerr << "block_log_converter:  error parsing command line: " << e.what() << "\n";
+         return 1;
+      }
+
+      if( options.count("help") )
+      {
+         std::cout << cli_options << "\n";
+         return 1;
+      }
+
+      if( !options.count("input") || !options.count("output") )
+      {
+         std::cerr << "--input and --output options are required\n";
+         return 1;
+      }
+
+      const fc::path input_dir = options["input"].as<boost::filesystem::path>();
+      const fc::path output_dir = options["output"].as<boost::filesystem::path>();
+      const size_t chunk_size = options["chunk-size"].as<uint32_t>();
+      const bool decompress = options.count("decompress") > 0;
+      FC_ASSERT( fc::exists( input_dir / "index" ), "No block database in ${d}", ("d",input_dir) );
+      const bool to_stdout = output_dir == fc::path( "-" );
+      FC_ASSERT( to_stdout || !fc::exists( output_dir / "index" ), "${d} already contains a block database",
+                 ("d",output_dir) );
+      FC_ASSERT( chunk_size > 0 && chunk_size <= block_database::max_chunk_size,
+                 "--chunk-size must be between 1 and ${m}", ("m",block_database::max_chunk_size) );
+
+      block_database input;
+      input.open( input_dir );
+      input.set_cache_size( 0 );
+      const auto last_id = input.last_id();
+      const uint32_t last_block_num = last_id.valid() ? block_header::num_from_id( *last_id ) : 0;
+
+      if( to_stdout )
+      {
+         uint32_t exported = 0;
+         for( uint32_t block_num = 1; block_num <= last_block_num; ++block_num )
+         {
+            vector<char> data;
+            block_id_type id;
+            if( !input.fetch_packed_by_number( block_num, data, id ) || data.empty() )
+               break; // importing stops at the first gap anyway
+            const uint32_t size = data.size();
+            std::cout.write( (const char*)&size, sizeof(size) );
+            std::cout.write( data.data(), data.size() );
+            ++exported;
+         }
+         std::cout.flush();
+         std::cerr << "Exported " << exported << " blocks\n";
+         return 0;
+      }
+
+      block_database output;
+      output.open( output_dir );
+      output.set_cache_size( 0 );
+      std::cerr << "Converting " << last_block_num << " blocks\n";
+
+      vector< std::pair<block_id_type, vector<char>> > chunk;
+      size_t chunk_bytes = 0;
+      auto flush_chunk = [&]() {
+         output.store_compressed( chunk );
+         chunk.clear();
+         chunk_bytes = 0;
+      };
+
+      uint32_t converted = 0;
+      for( uint32_t block_num = 1; block_num <= last_block_num; ++block_num )
+      {
+         vector<char> data;
+         block_id_type id;
+         if( !input.fetch_packed_by_number( block_num, data, id ) || data.empty() )
+            continue; // removed or never stored
+
+         if( decompress )
+            output.store( id, fc::raw::unpack<signed_block>( data ) );
+         else
+         {
+            // a block larger than a chunk gets a chunk of its own
+            if( !chunk.empty() && chunk_bytes + data.size() > chunk_size )
+               flush_chunk();
+            chunk_bytes += data.size();
+            chunk.emplace_back( id, std::move( data ) );
+         }
+         if( ++converted % 100000 == 0 )
+            std::cerr << "   " << block_num << "\n";
+      }
+      if( !chunk.empty() )
+         flush_chunk();
+
+      std::cerr << "Verifying\n";
+      for( uint32_t block_num = 1; block_num <= last_block_num; ++block_num )
+      {
+         vector<char> expected, actual;
+         block_id_type expected_id, actual_id;
+         if( !input.fetch_packed_by_number( block_num, expected, expected_id ) || expected.empty() )
+            continue;
+         FC_ASSERT( output.fetch_packed_by_number( block_num, actual, actual_id )
+                    && actual_id == expected_id && actual == expected,
+                    "Block ${n} differs after conversion", ("n",block_num) );
+      }
+
+      input.close();
+      output.close();
+      std::cerr << "Converted " << converted << " blocks, " << fc::file_size( input_dir / "blocks" ) << " bytes -> "
+                << fc::file_size( output_dir / "blocks" ) << " bytes\n";
+   }
+   catch ( const fc::exception& e )
+   {
+      std::cerr << e.to_detail_string() << "\n";
+      return 1;
+   }
+   return 0;
+}
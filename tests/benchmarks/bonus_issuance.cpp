@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+#include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/hardfork.hpp>
+
+#include <fc/time.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+BOOST_FIXTURE_TEST_SUITE( bonus_issuance, database_fixture )
+
+/**
+ *  Measures the maintenance block that pays the daily bonuses of a mining asset to every account,
+ *  half of the accounts having reported their online time.
+ */
+BOOST_AUTO_TEST_CASE( issue_bonuses_bench )
+{
+   try {
+
+      BOOST_TEST_MESSAGE( "=== issue_bonuses_bench ===" );
+
+#ifdef NDEBUG
+      const uint32_t account_count = 200000;
+#else
+      const uint32_t account_count = 100000;
+#endif
+      const int64_t account_balance = 1000000;
+
+      ACTOR( alice );
+      SET_ACTOR_CAN_CREATE_ASSET( alice_id );
+      trx.operations.clear();
+
+      generate_blocks( HARDFORK_621_TIME + fc::days( 1 ) );
+      set_expiration( db, trx );
+
+      asset_parameters ap;
+      ap.bonus_percent = 10000; // 10%
+      ap.daily_bonus = true;
+      ap.mining = true;
+      ap.maturing_bonus_balance = false;
+      ap.coin_maturing = false;
+      ap.mandatory_transfer = 0;
+      ap.fee_paying_asset = asset_id_type();
+      const asset_id_type bonus_asset = create_user_issued_asset( "BONUS", ap, alice_id ).id;
+      // nothing may stay pending, the objects created below are not part of a transaction
+      generate_block();
+
+      // accounts are created directly, pushing 100k account_create transactions would dominate the run
+      BOOST_TEST_MESSAGE( "creating " << account_count << " accounts..." );
+      vector<account_id_type> accounts;
+      accounts.reserve( account_count );
+      for( uint32_t i = 0; i < account_count; ++i )
+      {
+         accounts.push_back( db.create<account_object>( [&]( account_object& a ) {
+            a.name = "bench" + std::to_string( i );
+            a.statistics = db.create<account_statistics_object>( [&]( account_statistics_object& s ) { s.owner = a.id; } ).id;
+            a.owner.weight_threshold = 1;
+            a.active.weight_threshold = 1;
+            a.registrar = a.lifetime_referrer = a.referrer = GRAPHENE_COMMITTEE_ACCOUNT;
+         }).id );
+         db.adjust_balance( accounts.back(), asset( account_balance, bonus_asset ) );
+      }
+      db.modify( bonus_asset( db ).dynamic_asset_data_id( db ), [&]( asset_dynamic_data_object& d ) {
+         d.current_supply += account_balance * account_count;
+      });
+      for( uint32_t i = 0; i < account_count; i += 2 )
+         db.create<account_online_object>( [&]( account_online_object& o ) {
+            o.owner = accounts[i];
+            o.minutes = 720;
+         });
+
+      const auto start = fc::time_point::now();
+      generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+      const auto elapsed = fc::time_point::now() - start;
+      BOOST_TEST_MESSAGE( "maintenance with daily bonuses for " << account_count << " accounts took "
+                          << elapsed.count() / 1000 << " ms" );
+
+      BOOST_CHECK( db.get_balance( accounts[0], bonus_asset ).amount == account_balance + account_balance / 20 );
+      BOOST_CHECK( db.get_balance( accounts[1], bonus_asset ).amount == account_balance );
+   }
+   catch (fc::exception& e)
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/account_object.hpp>
+#include <graphene/db/object_database.hpp>
+
+#include <fc/time.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+#include <random>
+
+using namespace graphene::chain;
+
+BOOST_AUTO_TEST_SUITE( object_lookup )
+
+namespace {
+
+/** @return the average get_object() latency in nanoseconds over lookups of random existing ids */
+template<uint8_t DirectBits>
+double get_object_latency( uint32_t object_count, uint32_t lookups )
+{
+   graphene::db::object_database db;
+   db._undo_db.disable();
+   db.add_index< primary_index< account_balance_index, DirectBits > >();
+   for( uint32_t i = 0; i < object_count; ++i )
+      db.create<account_balance_object>( [&]( account_balance_object& b ) { b.owner = account_id_type(i); } );
+
+   std::mt19937 rng( 42 );
+   std::uniform_int_distribution<uint32_t> dist( 0, object_count - 1 );
+   vector<object_id_type> ids;
+   ids.reserve( lookups );
+   for( uint32_t i = 0; i < lookups; ++i )
+      ids.emplace_back( account_balance_object::space_id, account_balance_object::type_id, dist(rng) );
+
+   uint64_t checksum = 0;
+   const auto start = fc::time_point::now();
+   for( const auto& id : ids )
+      checksum += db.get_object( id ).id.instance();
+   const auto elapsed = fc::time_point::now() - start;
+   BOOST_CHECK( checksum > 0 );
+   return double( elapsed.count() ) * 1000 / lookups;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE( get_object_bench )
+{
+   try {
+
+      BOOST_TEST_MESSAGE( "=== get_object_bench ===" );
+
+#ifdef NDEBUG
+      const uint32_t object_count = 1000000;
+      const uint32_t lookups = 10000000;
+#else
+      const uint32_t object_count = 100000;
+      const uint32_t lookups = 1000000;
+#endif
+
+      const double ordered = get_object_latency<0>( object_count, lookups );
+      const double direct = get_object_latency<16>( object_count, lookups );
+      BOOST_TEST_MESSAGE( "get_object() on " << object_count << " objects: ordered index " << ordered
+                          << " ns, direct index " << direct << " ns per lookup" );
+   }
+   catch (fc::exception& e)
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -33,6 +33,7 @@
 #include <graphene/chain/proposal_object.hpp>
 
 #include <graphene/db/simple_index.hpp>
+#include <graphene/protocol/signature_cache.hpp>
 
 #include <fc/crypto/digest.hpp>
 #include "../common/database_fixture.hpp"
@@ -1361,4 +1362,83 @@ BOOST_FIXTURE_TEST_CASE( nonminimal_sig_test, database_fixture )
    }
 }
 
+BOOST_AUTO_TEST_CASE( signature_keys_cache )
+{
+   try
+   {
+      ACTORS( (alice)(bob) );
+      fund( alice );
+
+      signed_transaction tx;
+      transfer_operation op;
+      op.from = alice_id;
+      op.to = bob_id;
+      op.amount = asset(1);
+      tx.operations.push_back( op );
+      set_expiration( db, tx );
+      sign( tx, alice_private_key );
+
+      precomputable_transaction ptx( tx );
+      BOOST_CHECK( ptx.get_signature_keys( db.get_chain_id() ) == flat_set<public_key_type>{ alice_public_key } );
+      BOOST_CHECK( ptx.signees == flat_set<public_key_type>{ alice_public_key } );
+      BOOST_CHECK( ptx.id() == tx.id() );
+      BOOST_CHECK( ptx.sig_digest( db.get_chain_id() ) == tx.sig_digest( db.get_chain_id() ) );
+      BOOST_CHECK( tx.get_signature_keys( db.get_chain_id() ) == ptx.signees );
+
+      // changing the signatures or the signed content must not reuse the cached keys
+      tx.signatures.clear();
+      sign( tx, bob_private_key );
+      BOOST_CHECK( tx.get_signature_keys( db.get_chain_id() ) == flat_set<public_key_type>{ bob_public_key } );
+      tx.operations.push_back( op );
+      BOOST_CHECK( tx.get_signature_keys( db.get_chain_id() ) != flat_set<public_key_type>{ bob_public_key } );
+
+      signed_transaction copy = tx;
+      tx.signatures.push_back( tx.signatures.back() );
+      GRAPHENE_REQUIRE_THROW( tx.get_signature_keys( db.get_chain_id() ), tx_duplicate_sig );
+      BOOST_CHECK( copy.get_signature_keys( db.get_chain_id() ) == copy.signees );
+
+      // the memoized sizes and digests of a block match a full serialization
+      PUSH_TX( db, ptx );
+      signed_block block = generate_block();
+      BOOST_CHECK_EQUAL( block.packed_size(), fc::raw::pack_size( block ) );
+      BOOST_CHECK( block.transactions.front().merkle_digest() == digest_type::hash( block.transactions.front() ) );
+   }
+   catch(fc::exception& e)
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( signature_cache_eviction )
+{
+   try
+   {
+      graphene::protocol::signature_cache cache( 2 );
+      auto key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "cache" ) ) );
+      vector<fc::sha256> digests;
+      for( int i = 0; i < 3; ++i )
+         digests.push_back( fc::sha256::hash( fc::to_string( i ) ) );
+
+      for( const auto& d : digests )
+         BOOST_CHECK( cache.recover( key.sign_compact( d ), d ) == key.get_public_key() );
+      BOOST_CHECK_EQUAL( cache.size(), 2u );
+      BOOST_CHECK_EQUAL( cache.misses(), 3u );
+
+      // the oldest entry was evicted, the newest one is served from the cache
+      cache.recover( key.sign_compact( digests[2] ), digests[2] );
+      BOOST_CHECK_EQUAL( cache.hits(), 1u );
+      cache.recover( key.sign_compact( digests[0] ), digests[0] );
+      BOOST_CHECK_EQUAL( cache.misses(), 4u );
+
+      cache.set_capacity( 0 );
+      BOOST_CHECK_EQUAL( cache.size(), 0u );
+   }
+   catch(fc::exception& e)
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
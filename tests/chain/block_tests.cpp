@@ -32,13 +32,20 @@
 #include <graphene/chain/committee_member_object.hpp>
 #include <graphene/chain/proposal_object.hpp>
 #include <graphene/chain/market_object.hpp>
+#include <graphene/chain/operation_history_object.hpp>
+#include <graphene/chain/witness_object.hpp>
 
 #include <graphene/utilities/tempdir.hpp>
 
 #include <fc/crypto/digest.hpp>
+#include <fc/io/json.hpp>
 
 #include "../common/database_fixture.hpp"
 
+#include <atomic>
+#include <sstream>
+#include <thread>
+
 using namespace graphene::chain;
 using namespace graphene::chain::test;
 
@@ -128,6 +135,120 @@ BOOST_AUTO_TEST_CASE( block_database_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( block_database_compressed_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.open( data_dir.path() );
+
+      vector<signed_block> chain( 10 );
+      vector< std::pair<block_id_type, vector<char>> > chunk;
+      for( uint32_t i = 0; i < chain.size(); ++i )
+      {
+         if( i > 0 ) chain[i].previous = chain[i-1].id();
+         chain[i].witness = witness_id_type(i+1);
+         bdb.store( chain[i].id(), chain[i] );
+         if( i < 6 )
+            chunk.emplace_back( chain[i].id(), fc::raw::pack( chain[i] ) );
+      }
+
+      // move the first six blocks into a compressed chunk, the rest stays plain
+      bdb.store_compressed( chunk );
+      for( size_t cache_size : { block_database::default_cache_size, size_t(0) } )
+      {
+         bdb.set_cache_size( cache_size );
+         for( uint32_t i = 0; i < chain.size(); ++i )
+         {
+            auto blk = bdb.fetch_by_number( i+1 );
+            BOOST_REQUIRE( blk.valid() );
+            BOOST_CHECK( blk->id() == chain[i].id() );
+            BOOST_CHECK( bdb.fetch_optional( chain[i].id() ).valid() );
+         }
+      }
+
+      bdb.remove( chain[2].id() );
+      BOOST_CHECK( !bdb.fetch_by_number( 3 ).valid() );
+      BOOST_CHECK( !bdb.contains( chain[2].id() ) );
+
+      bdb.close();
+      bdb.open( data_dir.path() );
+      BOOST_CHECK( bdb.fetch_by_number( 2 )->id() == chain[1].id() );
+      BOOST_CHECK( *bdb.last_id() == chain.back().id() );
+
+      vector<char> data;
+      block_id_type id;
+      BOOST_REQUIRE( bdb.fetch_packed_by_number( 6, data, id ) );
+      BOOST_CHECK( id == chain[5].id() );
+      BOOST_CHECK( data == fc::raw::pack( chain[5] ) );
+      bdb.close();
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_cache_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.open( data_dir.path() );
+
+      vector<signed_block> chain( 20 );
+      for( uint32_t i = 0; i < chain.size(); ++i )
+      {
+         if( i > 0 ) chain[i].previous = chain[i-1].id();
+         chain[i].witness = witness_id_type(i+1);
+         bdb.store( chain[i].id(), chain[i] );
+      }
+
+      // a block of another fork replaces block 10, the old one must not be served from the cache
+      signed_block fork = chain[9];
+      fork.witness = witness_id_type(100);
+      BOOST_REQUIRE( bdb.fetch_optional( chain[9].id() ).valid() );
+      bdb.store( fork.id(), fork );
+      BOOST_CHECK( !bdb.fetch_optional( chain[9].id() ).valid() );
+      BOOST_CHECK( bdb.fetch_by_number( 10 )->witness == witness_id_type(100) );
+
+      bdb.remove( fork.id() );
+      BOOST_CHECK( !bdb.fetch_optional( fork.id() ).valid() );
+      BOOST_CHECK( !bdb.fetch_by_number( 10 ).valid() );
+      BOOST_CHECK( !bdb.contains( fork.id() ) );
+      bdb.store( chain[9].id(), chain[9] );
+
+      // concurrent readers, with and without the cache, while the head block is being replaced
+      for( size_t cache_size : { size_t(0), size_t(4) } )
+      {
+         bdb.set_cache_size( cache_size );
+         std::atomic<bool> failed( false );
+         vector<std::thread> readers;
+         for( int t = 0; t < 4; ++t )
+            readers.emplace_back( [&bdb,&chain,&failed] () {
+               for( int n = 0; n < 200; ++n )
+               {
+                  const uint32_t num = n % 19 + 1;
+                  auto blk = bdb.fetch_by_number( num );
+                  if( !blk.valid() || blk->id() != chain[num-1].id() || !bdb.contains( chain[num-1].id() ) )
+                     failed = true;
+               }
+            });
+         for( int n = 0; n < 50; ++n )
+            bdb.store( chain.back().id(), chain.back() );
+         for( auto& reader : readers )
+            reader.join();
+         BOOST_CHECK( !failed );
+      }
+
+      bdb.close();
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( generate_empty_blocks )
 {
    try {
@@ -304,6 +425,257 @@ BOOST_AUTO_TEST_CASE( fork_blocks )
    }
 }
 
+BOOST_AUTO_TEST_CASE( fork_switch_back )
+{
+   try {
+      fc::temp_directory data_dir1( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir2( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir3( graphene::utilities::temp_directory_path() );
+
+      database db1;
+      db1.open(data_dir1.path(), make_genesis);
+      database db2;
+      db2.open(data_dir2.path(), make_genesis);
+      database db3;
+      db3.open(data_dir3.path(), make_genesis);
+
+      // db1 and db2 have an applied_block listener that keeps objects of its own, like the history plugin
+      auto record_history = []( database& db, const signed_block& b ) {
+         uint32_t count = 0;
+         for( const auto& op : db.get_applied_operations() )
+            if( op.valid() )
+            {
+               db.create<operation_history_object>( [&op]( operation_history_object& h ){
+                  h.op = op->op;
+                  h.result = op->result;
+                  h.block_num = op->block_num;
+               } );
+               ++count;
+            }
+         db.modify( b.witness(db).witness_account(db).statistics(db), [count]( account_statistics_object& s ){
+            s.total_ops += count + 1;
+         });
+      };
+      for( database* db : { &db1, &db2 } )
+      {
+         db->add_index< primary_index< operation_history_index > >();
+         db->applied_block.connect( [db,&record_history]( const signed_block& b ){ record_history( *db, b ); } );
+      }
+
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      for( uint32_t i = 0; i < 10; ++i )
+      {
+         auto b = db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+         PUSH_BLOCK( db2, b );
+         PUSH_BLOCK( db3, b );
+      }
+
+      // db2 follows branch A of db1, which has operations for the listener
+      signed_transaction trx;
+      set_expiration( db1, trx );
+      account_create_operation cop;
+      cop.registrar = GRAPHENE_TEMP_ACCOUNT;
+      cop.name = "nathan";
+      cop.owner = authority( 1, public_key_type( init_account_priv_key.get_public_key() ), 1 );
+      cop.active = cop.owner;
+      trx.operations.push_back( cop );
+      PUSH_TX( db1, trx );
+      for( uint32_t i = 0; i < 2; ++i )
+         PUSH_BLOCK( db2, db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing) );
+
+      // then switches to the longer branch B of db3
+      uint32_t next_slot = 3;
+      for( uint32_t i = 0; i < 3; ++i )
+      {
+         PUSH_BLOCK( db2, db3.generate_block(db3.get_slot_time(next_slot), db3.get_scheduled_witness(next_slot), init_account_priv_key, database::skip_nothing) );
+         next_slot = 1;
+      }
+      BOOST_CHECK( db2.head_block_id() == db3.head_block_id() );
+      BOOST_CHECK_EQUAL( db2.get_fork_switch_stats().switches, 1u );
+      BOOST_CHECK_EQUAL( db2.get_fork_switch_stats().last_depth, 2u );
+
+      // and back to A once it is longer, restoring the blocks it had applied before
+      for( uint32_t i = 0; i < 3; ++i )
+         PUSH_BLOCK( db2, db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing) );
+      BOOST_CHECK( db2.head_block_id() == db1.head_block_id() );
+      BOOST_CHECK_EQUAL( db2.get_fork_switch_stats().switches, 2u );
+      BOOST_CHECK_EQUAL( db2.get_fork_switch_stats().last_depth, 3u );
+      BOOST_CHECK_EQUAL( db2.get_fork_switch_stats().blocks_redone, 2u );
+      BOOST_CHECK_EQUAL( fc::json::to_string( db2.get_dynamic_global_properties() ),
+                         fc::json::to_string( db1.get_dynamic_global_properties() ) );
+      // the listener saw the redone blocks with their operations, once
+      BOOST_CHECK_EQUAL( db2.get_index_type< operation_history_index >().indices().size(),
+                         db1.get_index_type< operation_history_index >().indices().size() );
+      BOOST_CHECK( db2.get_index_type< operation_history_index >().indices().size() > 0 );
+      BOOST_CHECK( db2.compute_state_fingerprint().digest == db1.compute_state_fingerprint().digest );
+
+      // the restored state is good enough for db1 to accept db2's next block
+      PUSH_BLOCK( db1, db2.generate_block(db2.get_slot_time(1), db2.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing) );
+      BOOST_CHECK( db1.head_block_id() == db2.head_block_id() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( fork_database_size_limit )
+{
+   try {
+      fc::temp_directory data_dir1( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir2( graphene::utilities::temp_directory_path() );
+
+      database db1;
+      db1.open(data_dir1.path(), make_genesis);
+      database db2;
+      db2.open(data_dir2.path(), make_genesis);
+
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      vector<signed_block> chain;
+      for( uint32_t i = 0; i < 7; ++i )
+      {
+         chain.push_back( db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing) );
+         if( i < 3 )
+            PUSH_BLOCK( db2, chain.back() );
+      }
+      vector<signed_block> side;
+      for( uint32_t i = 0; i < 4; ++i )
+         side.push_back( db2.generate_block(db2.get_slot_time(3), db2.get_scheduled_witness(3), init_account_priv_key, database::skip_nothing) );
+
+      fork_database fork_db;
+      fork_db.start_block( chain[0] );
+      for( uint32_t i = 1; i < 5; ++i )
+         fork_db.push_block( chain[i], "peer_a" );
+      for( uint32_t i = 0; i < 2; ++i )
+         fork_db.push_block( side[i], "peer_b" );
+      GRAPHENE_CHECK_THROW( fork_db.push_block( chain[6], "peer_b" ), fc::exception );
+      BOOST_CHECK( fork_db.head()->id == chain[4].id() );
+
+      auto stats = fork_db.get_stats();
+      BOOST_CHECK_EQUAL( stats.blocks, 7u );
+      BOOST_CHECK_EQUAL( stats.unlinkable, 1u );
+      BOOST_CHECK_EQUAL( stats.sources["peer_a"].blocks, 4u );
+      BOOST_CHECK_EQUAL( stats.sources["peer_b"].blocks, 2u );
+      BOOST_CHECK_EQUAL( stats.sources["peer_b"].unlinkable, 1u );
+      const uint64_t side_bytes = stats.sources["peer_b"].bytes;
+      BOOST_CHECK_EQUAL( side_bytes, side[0].packed_size() + side[1].packed_size() );
+
+      // going over the limit evicts the side branch, never the chain of the head block
+      fork_db.set_max_bytes( stats.bytes - 1 );
+      stats = fork_db.get_stats();
+      BOOST_CHECK_EQUAL( stats.blocks, 5u );
+      BOOST_CHECK_EQUAL( stats.evicted, 2u );
+      BOOST_CHECK_EQUAL( stats.evicted_bytes, side_bytes );
+      BOOST_CHECK_EQUAL( stats.sources["peer_b"].blocks, 0u );
+      BOOST_CHECK_EQUAL( stats.sources["peer_b"].evicted, 2u );
+      BOOST_CHECK( !fork_db.is_known_block( side[0].id() ) );
+      BOOST_CHECK( fork_db.head()->id == chain[4].id() );
+
+      fork_db.set_max_bytes( 0 );
+      fork_db.push_block( chain[5], "peer_a" );
+      BOOST_CHECK( fork_db.head()->id == chain[5].id() );
+      BOOST_CHECK_EQUAL( fork_db.get_stats().blocks, 6u );
+
+      // a longer fork is the head before the caller switched to it, the chain it has applied stays
+      for( const auto& b : side )
+         fork_db.push_block( b, "peer_b" );
+      BOOST_CHECK( fork_db.head()->id == side.back().id() );
+      fork_db.evict_side_blocks( chain[5].id() );
+      BOOST_CHECK_EQUAL( fork_db.get_stats().blocks, 10u );
+      BOOST_CHECK_EQUAL( fork_db.fetch_branch_from( side.back().id(), chain[5].id() ).second.size(), 3u );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( checkpointed_blocks )
+{
+   try {
+      fc::temp_directory data_dir1( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir2( graphene::utilities::temp_directory_path() );
+
+      database db1;
+      db1.open(data_dir1.path(), make_genesis);
+      database db2;
+      db2.open(data_dir2.path(), make_genesis);
+
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      for( uint32_t i = 0; i < 10; ++i )
+         db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+
+      db2.add_checkpoints( { { 8, db1.fetch_block_by_number( 8 )->id() } } );
+      BOOST_CHECK( db2.is_checkpointed( 8 ) );
+      BOOST_CHECK( !db2.is_checkpointed( 9 ) );
+      for( uint32_t num = 1; num <= 10; ++num )
+         PUSH_BLOCK( db2, *db1.fetch_block_by_number( num ) );
+      BOOST_CHECK( db2.head_block_id() == db1.head_block_id() );
+
+      // the blocks after the checkpoint can be undone, the checkpointed ones can not
+      db2.pop_block();
+      db2.pop_block();
+      BOOST_CHECK_EQUAL( db2.head_block_num(), 8u );
+      GRAPHENE_CHECK_THROW( db2.pop_block(), fc::exception );
+      BOOST_CHECK_EQUAL( db2.head_block_num(), 8u );
+
+      // a block that does not match the checkpoint is rejected
+      database db3;
+      fc::temp_directory data_dir3( graphene::utilities::temp_directory_path() );
+      db3.open(data_dir3.path(), make_genesis);
+      db3.add_checkpoints( { { 2, db1.fetch_block_by_number( 1 )->id() } } );
+      PUSH_BLOCK( db3, *db1.fetch_block_by_number( 1 ) );
+      GRAPHENE_CHECK_THROW( PUSH_BLOCK( db3, *db1.fetch_block_by_number( 2 ) ), fc::exception );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( import_blocks )
+{
+   try {
+      fc::temp_directory data_dir1( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir2( graphene::utilities::temp_directory_path() );
+
+      database db1;
+      db1.open(data_dir1.path(), make_genesis);
+      database db2;
+      db2.open(data_dir2.path(), make_genesis);
+
+      auto init_account_priv_key  = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      for( uint32_t i = 0; i < 20; ++i )
+         db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+
+      // the first 15 blocks from db1's block database
+      block_database source;
+      source.open( data_dir1.path() / "database" / "block_num_to_block" );
+      BOOST_CHECK_EQUAL( db2.import_blocks( source, 15 ), 15u );
+      BOOST_CHECK_EQUAL( db2.head_block_num(), 15u );
+      BOOST_CHECK( db2.head_block_id() == db1.fetch_block_by_number( 15 )->id() );
+      source.close();
+
+      // the rest from a block stream, starting before the head block
+      std::stringstream stream;
+      for( uint32_t num = 10; num <= 20; ++num )
+      {
+         const auto data = fc::raw::pack( *db1.fetch_block_by_number( num ) );
+         const uint32_t size = data.size();
+         stream.write( (const char*)&size, sizeof(size) );
+         stream.write( data.data(), data.size() );
+      }
+      BOOST_CHECK_EQUAL( db2.import_blocks( stream, std::numeric_limits<uint32_t>::max() ), 5u );
+      BOOST_CHECK( db2.head_block_id() == db1.head_block_id() );
+      BOOST_CHECK( db2.fetch_block_by_number( 20 ).valid() );
+
+      // both continue on the same chain
+      auto b = db2.generate_block(db2.get_slot_time(1), db2.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+      PUSH_BLOCK( db1, b );
+      BOOST_CHECK( db1.head_block_id() == db2.head_block_id() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 
 /**
  *  These test has been disabled, out of order blocks should result in the node getting disconnected.
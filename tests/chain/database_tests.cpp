@@ -28,6 +28,8 @@
 
 #include <graphene/chain/account_object.hpp>
 
+#include <graphene/utilities/tempdir.hpp>
+
 #include <fc/crypto/digest.hpp>
 
 #include "../common/database_fixture.hpp"
@@ -62,3 +64,309 @@ BOOST_AUTO_TEST_CASE( undo_test )
       throw;
    }
 }
+
+BOOST_AUTO_TEST_CASE( undo_merge_test )
+{
+   try {
+
+      BOOST_TEST_MESSAGE( "=== undo_merge_test ===" );
+
+      database db;
+      const auto id0 = db.create<account_balance_object>( []( account_balance_object& obj ){ obj.owner = account_id_type(0); } ).id;
+      const auto id1 = db.create<account_balance_object>( []( account_balance_object& obj ){ obj.owner = account_id_type(1); } ).id;
+
+      auto outer = db._undo_db.start_undo_session();
+      db.modify( db.get<account_balance_object>( id0 ), []( account_balance_object& obj ){ obj.balance = 1; } );
+      {
+         // the saved copies of the inner session are handed over to the outer one on merge
+         auto inner = db._undo_db.start_undo_session();
+         db.modify( db.get<account_balance_object>( id0 ), []( account_balance_object& obj ){ obj.balance = 2; } );
+         db.modify( db.get<account_balance_object>( id1 ), []( account_balance_object& obj ){ obj.balance = 3; } );
+         db.remove( db.get<account_balance_object>( id1 ) );
+         inner.merge();
+      }
+      BOOST_CHECK_EQUAL( db.get<account_balance_object>( id0 ).balance.value, 2 );
+      BOOST_CHECK( db.find<account_balance_object>( id1 ) == nullptr );
+
+      outer.undo();
+      BOOST_CHECK_EQUAL( db.get<account_balance_object>( id0 ).balance.value, 0 );
+      BOOST_CHECK_EQUAL( db.get<account_balance_object>( id1 ).balance.value, 0 );
+      BOOST_CHECK( db.get<account_balance_object>( id1 ).owner == account_id_type(1) );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( typed_modify_test )
+{
+   try {
+
+      BOOST_TEST_MESSAGE( "=== typed_modify_test ===" );
+
+      database db;
+      const auto& idx = db.get_index_type<account_balance_index>().indices().get<by_account_asset>();
+      const auto id0 = db.create<account_balance_object>( []( account_balance_object& obj ){ obj.owner = account_id_type(0); } ).id;
+
+      {
+         auto session = db._undo_db.start_undo_session();
+         const auto& created = db.typed_create<account_balance_index>( []( account_balance_object& obj ){
+            obj.owner = account_id_type(1);
+            obj.balance = 5;
+         } );
+         BOOST_CHECK( db.find_object( created.id ) == &created );
+         db.typed_modify<account_balance_index>( db.get<account_balance_object>( id0 ), []( account_balance_object& obj ){
+            obj.owner = account_id_type(2);
+            obj.balance = 7;
+         } );
+         // the multi_index keys are updated as with modify()
+         BOOST_CHECK( idx.find( boost::make_tuple( account_id_type(2), asset_id_type() ) ) != idx.end() );
+         BOOST_CHECK( idx.find( boost::make_tuple( account_id_type(0), asset_id_type() ) ) == idx.end() );
+      }
+
+      BOOST_CHECK_EQUAL( db.get<account_balance_object>( id0 ).balance.value, 0 );
+      BOOST_CHECK( idx.find( boost::make_tuple( account_id_type(0), asset_id_type() ) ) != idx.end() );
+      BOOST_CHECK( idx.find( boost::make_tuple( account_id_type(1), asset_id_type() ) ) == idx.end() );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( delta_undo_test )
+{
+   try {
+
+      BOOST_TEST_MESSAGE( "=== delta_undo_test ===" );
+
+      typedef undo_recorder<accounts_online_object> recorder;
+      database db;
+      const auto id = db.create<accounts_online_object>( []( accounts_online_object& obj ){
+         obj.online_info[account_id_type(1)] = 10;
+         obj.online_info[account_id_type(2)] = 20;
+      } ).id;
+      auto online = [&]() -> const map<account_id_type, uint16_t>& { return db.get<accounts_online_object>( id ).online_info; };
+
+      auto outer = db._undo_db.start_undo_session();
+      db.modify_with_delta( db.get<accounts_online_object>( id ), []( accounts_online_object& obj, recorder& undo ){
+         undo.save_entry( &accounts_online_object::online_info, account_id_type(1) );
+         obj.online_info[account_id_type(1)] = 11;
+      } );
+      {
+         // deltas of the inner session are appended to those of the outer one on merge
+         auto inner = db._undo_db.start_undo_session();
+         db.modify_with_delta( db.get<accounts_online_object>( id ), []( accounts_online_object& obj, recorder& undo ){
+            undo.save_entry( &accounts_online_object::online_info, account_id_type(3) );
+            obj.online_info[account_id_type(3)] = 30;
+         } );
+         db.modify_with_delta( db.get<accounts_online_object>( id ), []( accounts_online_object& obj, recorder& undo ){
+            undo.take( &accounts_online_object::online_info );
+            obj.online_info[account_id_type(4)] = 40;
+         } );
+         inner.merge();
+      }
+      BOOST_CHECK_EQUAL( online().size(), 1u );
+
+      // a plain modify after the deltas turns them into a full copy
+      db.modify( db.get<accounts_online_object>( id ), []( accounts_online_object& obj ){ obj.online_info.clear(); } );
+
+      outer.undo();
+      BOOST_REQUIRE_EQUAL( online().size(), 2u );
+      BOOST_CHECK_EQUAL( online().at(account_id_type(1)), 10 );
+      BOOST_CHECK_EQUAL( online().at(account_id_type(2)), 20 );
+
+      {
+         auto session = db._undo_db.start_undo_session();
+         db.modify_with_delta( db.get<accounts_online_object>( id ), []( accounts_online_object& obj, recorder& undo ){
+            undo.take( &accounts_online_object::online_info );
+         } );
+         BOOST_CHECK( online().empty() );
+      }
+      BOOST_CHECK_EQUAL( online().size(), 2u );
+
+      // vector members record single insertions, changes and erasures
+      typedef undo_recorder<account_mature_balance_object> mature_recorder;
+      const auto mature_id = db.create<account_mature_balance_object>( []( account_mature_balance_object& obj ){
+         obj.balance = 100;
+         obj.history.push_back( mature_balances_history( 100, 100 ) );
+      } ).id;
+      auto mature = [&]() -> const account_mature_balance_object& { return db.get<account_mature_balance_object>( mature_id ); };
+      {
+         auto session = db._undo_db.start_undo_session();
+         db.modify_with_delta( mature(), []( account_mature_balance_object& obj, mature_recorder& undo ){
+            obj.adjust_balance( asset( 50 ), asset( 50 ), 1000, undo );
+         } );
+         BOOST_CHECK_EQUAL( mature().history.size(), 2u );
+         // takes the whole last entry and half of the first one
+         db.modify_with_delta( mature(), []( account_mature_balance_object& obj, mature_recorder& undo ){
+            obj.adjust_balance( asset( -100 ), asset( -100 ), 1000, undo );
+         } );
+         BOOST_CHECK_EQUAL( mature().history.size(), 1u );
+         BOOST_CHECK_EQUAL( mature().balance.value, 50 );
+      }
+      BOOST_REQUIRE_EQUAL( mature().history.size(), 1u );
+      BOOST_CHECK_EQUAL( mature().history[0].real_balance.value, 100 );
+      BOOST_CHECK_EQUAL( mature().history[0].balance.value, 100 );
+      BOOST_CHECK_EQUAL( mature().balance.value, 100 );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( state_fingerprint_test )
+{
+   try {
+
+      BOOST_TEST_MESSAGE( "=== state_fingerprint_test ===" );
+
+      database db;
+      db.create<account_balance_object>( []( account_balance_object& obj ){ obj.owner = account_id_type(0); } );
+      const auto initial = db.compute_state_fingerprint();
+
+      db.enable_state_fingerprint();
+      BOOST_CHECK( db.get_state_fingerprint().digest == initial.digest );
+
+      {
+         auto session = db._undo_db.start_undo_session();
+         const auto id = db.create<account_balance_object>( []( account_balance_object& obj ){ obj.owner = account_id_type(1); } ).id;
+         db.modify( db.get<account_balance_object>( id ), []( account_balance_object& obj ){ obj.balance = 10; } );
+         const auto tracked = db.get_state_fingerprint();
+         BOOST_CHECK( tracked.digest == db.compute_state_fingerprint().digest );
+         BOOST_CHECK( tracked.digest != initial.digest );
+      }
+
+      // undo goes through the same hooks
+      BOOST_CHECK( db.get_state_fingerprint().digest == initial.digest );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( pool_allocated_index_test )
+{
+   try {
+
+      BOOST_TEST_MESSAGE( "=== pool_allocated_index_test ===" );
+
+      graphene::db::object_database db;
+      db.add_index< primary_index< operation_history_index > >();
+      vector<object_id_type> ids;
+      for( uint32_t i = 0; i < 1000; ++i )
+         ids.push_back( db.create<operation_history_object>( [i]( operation_history_object& obj ){ obj.block_num = i; } ).id );
+
+      auto stats = db.get_index_type< operation_history_index >().memory_stats();
+      BOOST_CHECK_EQUAL( stats.object_count, 1000u );
+      BOOST_CHECK( stats.used_bytes >= 1000 * sizeof(operation_history_object) );
+      BOOST_CHECK( stats.reserved_bytes >= stats.used_bytes );
+      BOOST_CHECK_EQUAL( db.get<operation_history_object>( ids[500] ).block_num, 500u );
+
+      for( const auto& id : ids )
+         db.remove( db.get_object( id ) );
+      const auto reserved = stats.reserved_bytes;
+      stats = db.get_index_type< operation_history_index >().memory_stats();
+      BOOST_CHECK_EQUAL( stats.object_count, 0u );
+      BOOST_CHECK( stats.used_bytes < 1000 * sizeof(operation_history_object) );
+      BOOST_CHECK_EQUAL( stats.reserved_bytes, reserved );
+
+      // the freed nodes are reused
+      for( uint32_t i = 0; i < 1000; ++i )
+         db.create<operation_history_object>( [i]( operation_history_object& obj ){ obj.block_num = i; } );
+      BOOST_CHECK_EQUAL( db.get_index_type< operation_history_index >().memory_stats().reserved_bytes, reserved );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( incremental_flush_test )
+{
+   try {
+
+      BOOST_TEST_MESSAGE( "=== incremental_flush_test ===" );
+
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      account_balance_id_type id0, id1, id2, id3;
+      {
+         database db;
+         db.set_snapshot_compaction_interval( 2 );
+         db.object_database::open( data_dir.path() );
+         BOOST_CHECK( !db.tracking_changes() );
+
+         id0 = db.create<account_balance_object>( []( account_balance_object& obj ){ obj.owner = account_id_type(0); } ).id;
+         id1 = db.create<account_balance_object>( []( account_balance_object& obj ){ obj.owner = account_id_type(1); } ).id;
+         id2 = db.create<account_balance_object>( []( account_balance_object& obj ){ obj.owner = account_id_type(2); } ).id;
+         // no snapshot on disk yet, this is a full rewrite
+         db.flush();
+         BOOST_CHECK( db.tracking_changes() );
+
+         db.modify( db.get<account_balance_object>( id0 ), []( account_balance_object& obj ){ obj.balance = 100; } );
+         db.remove( db.get<account_balance_object>( id1 ) );
+         // reuses the unique (owner, asset) key of the removed object
+         id3 = db.create<account_balance_object>( []( account_balance_object& obj ){ obj.owner = account_id_type(1); } ).id;
+         db.flush();
+
+         const auto delta = data_dir.path() / "object_database" / fc::to_string( uint32_t( account_balance_object::space_id ) )
+                                          / ( fc::to_string( uint32_t( account_balance_object::type_id ) ) + ".delta.1" );
+         BOOST_CHECK( fc::exists( delta ) );
+      }
+      {
+         database db;
+         db.set_snapshot_compaction_interval( 2 );
+         db.object_database::open( data_dir.path() );
+         BOOST_CHECK( db.tracking_changes() );
+
+         BOOST_CHECK_EQUAL( db.get<account_balance_object>( id0 ).balance.value, 100 );
+         BOOST_CHECK( db.find<account_balance_object>( id1 ) == nullptr );
+         BOOST_CHECK( db.get<account_balance_object>( id2 ).owner == account_id_type(2) );
+         BOOST_CHECK( db.get<account_balance_object>( id3 ).owner == account_id_type(1) );
+         BOOST_CHECK( db.get_index<account_balance_object>().get_next_id() == object_id_type( id3 ) + 1 );
+      }
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( corrupted_snapshot_test )
+{
+   try {
+
+      BOOST_TEST_MESSAGE( "=== corrupted_snapshot_test ===" );
+
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      const auto file = data_dir.path() / "object_database" / fc::to_string( uint32_t( account_balance_object::space_id ) )
+                                        / fc::to_string( uint32_t( account_balance_object::type_id ) );
+      {
+         database db;
+         db.object_database::open( data_dir.path() );
+         for( int i = 0; i < 10; ++i )
+            db.create<account_balance_object>( [i]( account_balance_object& obj ){ obj.owner = account_id_type(i); } );
+         db.flush();
+      }
+      {
+         database db;
+         db.verify( data_dir.path() );
+      }
+
+      // cut off the last object, this used to result in a silently truncated index
+      const auto size = fc::file_size( file );
+      fc::resize_file( file, size - 40 );
+      {
+         database db;
+         BOOST_CHECK_THROW( db.verify( data_dir.path() ), fc::exception );
+         BOOST_CHECK_THROW( db.object_database::open( data_dir.path() ), fc::exception );
+      }
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
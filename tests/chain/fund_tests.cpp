@@ -390,18 +390,19 @@ BOOST_AUTO_TEST_CASE( fund_make_payments_test )
 
       auto fund_iter = db.get_index_type<fund_index>().indices().get<by_name>().find("TESTFUND");
       BOOST_CHECK(fund_iter != db.get_index_type<fund_index>().indices().get<by_name>().end());
-      const fund_object& fund = *fund_iter;
+      // generate_block() recreates the fund from the undo state, keep its id only
+      const fund_id_type fund_id = fund_iter->get_id();
 
       // alice, fund owner: refilling with full its amount
       fund_refill_operation fro;
       fro.amount = 10000; // minimal available deposit
       fro.fee = asset();
       fro.from_account = alice_id;
-      fro.id = fund.get_id();
+      fro.id = fund_id;
       trx.operations.push_back(std::move(fro));
       PUSH_TX(db, trx, ~0);
       trx.clear();
-      BOOST_CHECK(fund.balance == 10000);
+      BOOST_CHECK(fund_id(db).balance == 10000);
       BOOST_CHECK(get_balance(alice_id, EDC_ASSET) == 0);
 
       // bob: deposit
@@ -410,22 +411,22 @@ BOOST_AUTO_TEST_CASE( fund_make_payments_test )
       fdo.fee = asset();
       fdo.from_account = bob_id;
       fdo.period = 50;
-      fdo.fund_id = fund.get_id();
+      fdo.fund_id = fund_id;
       trx.operations.push_back(std::move(fdo));
       PUSH_TX(db, trx, ~0);
       trx.clear();
-      BOOST_CHECK(fund.balance == 20000);
+      BOOST_CHECK(fund_id(db).balance == 20000);
       BOOST_CHECK(get_balance(bob_id, EDC_ASSET) == 0);
 
       // first maintenance_time
       generate_blocks(db.get_dynamic_global_properties().next_maintenance_time);
 
       // history
-      BOOST_CHECK(fund.history_id(db).items.size() == 1);
-      BOOST_CHECK(fund.history_id(db).items[0].create_datetime.sec_since_epoch() == db.head_block_time().sec_since_epoch());
-      BOOST_CHECK(fund.history_id(db).items[0].daily_payments_total.value == 200);
-      BOOST_CHECK(fund.history_id(db).items[0].daily_payments_without_owner.value == 40);
-      BOOST_CHECK(fund.history_id(db).items[0].daily_payments_owner.value == 160);
+      BOOST_CHECK(fund_id(db).history_id(db).items.size() == 1);
+      BOOST_CHECK(fund_id(db).history_id(db).items[0].create_datetime.sec_since_epoch() == db.head_block_time().sec_since_epoch());
+      BOOST_CHECK(fund_id(db).history_id(db).items[0].daily_payments_total.value == 200);
+      BOOST_CHECK(fund_id(db).history_id(db).items[0].daily_payments_without_owner.value == 40);
+      BOOST_CHECK(fund_id(db).history_id(db).items[0].daily_payments_owner.value == 160);
 
       // std::cout << "========= 1 alice's balance: " << get_balance(alice_id, EDC_ASSET) << std::endl;
       // std::cout << "========= 1 bob's balance: " << get_balance(bob_id, EDC_ASSET) << std::endl;
@@ -451,7 +452,7 @@ BOOST_AUTO_TEST_CASE( fund_make_payments_test )
       }
 
       // history
-      BOOST_CHECK(fund.history_id(db).items.size() == 50);
+      BOOST_CHECK(fund_id(db).history_id(db).items.size() == 50);
 
       // std::cout << "========= 2 alice's balance: " << get_balance(alice_id, EDC_ASSET) << std::endl;
       // std::cout << "========= 2 bob's balance: " << get_balance(bob_id, EDC_ASSET) << std::endl;
@@ -473,20 +474,20 @@ BOOST_AUTO_TEST_CASE( fund_make_payments_test )
       // alice has fund amount + percent
       BOOST_CHECK(get_balance(alice_id, EDC_ASSET) == 16825);
 
-      BOOST_CHECK(!fund.enabled);
-      BOOST_CHECK(fund.balance == 0);
+      BOOST_CHECK(!fund_id(db).enabled);
+      BOOST_CHECK(fund_id(db).balance == 0);
 
       /************* owner's fixed percent **************/
 
       // enable fund
       fund_set_enable_operation en_op;
-      en_op.id      = fund.get_id();
+      en_op.id      = fund_id;
       en_op.enabled = true;
       set_expiration(db, trx);
       trx.operations.push_back(std::move(en_op));
       PUSH_TX(db, trx, ~0);
       trx.clear();
-      BOOST_CHECK(fund.enabled);
+      BOOST_CHECK(fund_id(db).enabled);
 
       /**
        * update fund options: we need new period of it and
@@ -510,7 +511,7 @@ BOOST_AUTO_TEST_CASE( fund_make_payments_test )
          options2.payment_rates.push_back(std::move(pr2));
 
          fund_update_operation uop2;
-         uop2.id = fund.get_id();
+         uop2.id = fund_id;
          uop2.options = options2;
          set_expiration(db, trx);
          trx.operations.push_back(uop2);
@@ -528,24 +529,24 @@ BOOST_AUTO_TEST_CASE( fund_make_payments_test )
       fdo2.fee = asset();
       fdo2.from_account = bob_id;
       fdo2.period = 50;
-      fdo2.fund_id = fund.get_id();
+      fdo2.fund_id = fund_id;
       set_expiration(db, trx);
       trx.operations.push_back(std::move(fdo2));
       PUSH_TX(db, trx, ~0);
       trx.clear();
-      BOOST_CHECK(fund.balance == 30000);
+      BOOST_CHECK(fund_id(db).balance == 30000);
       BOOST_CHECK(get_balance(bob_id, EDC_ASSET) == 0);
 
       // 'fund_change_payment_scheme_operation'
       fund_change_payment_scheme_operation sf_op;
-      sf_op.id = fund.get_id();
+      sf_op.id = fund_id;
       sf_op.payment_scheme = 1;
       set_expiration(db, trx);
       trx.operations.push_back(std::move(sf_op));
       PUSH_TX(db, trx, ~0);
       trx.clear();
 
-      BOOST_CHECK(fund.payment_scheme == fund_payment_scheme::fixed);
+      BOOST_CHECK(fund_id(db).payment_scheme == fund_payment_scheme::fixed);
 
       /**
        * at current moment:
@@ -560,7 +561,7 @@ BOOST_AUTO_TEST_CASE( fund_make_payments_test )
          fund_refill_operation fro;
          fro.fee = asset();
          fro.from_account = alice_id;
-         fro.id = fund.get_id();
+         fro.id = fund_id;
          fro.amount = 10000;
 
          trx.clear();
@@ -568,8 +569,8 @@ BOOST_AUTO_TEST_CASE( fund_make_payments_test )
          trx.operations.push_back(std::move(fro));
          PUSH_TX(db, trx, ~0);
 
-         BOOST_CHECK(fund.balance == 40000);
-         BOOST_CHECK(fund.owner_balance == 10000);
+         BOOST_CHECK(fund_id(db).balance == 40000);
+         BOOST_CHECK(fund_id(db).owner_balance == 10000);
       }
 
       h_time = db.head_block_time() + fc::days(1);
@@ -920,7 +921,7 @@ BOOST_AUTO_TEST_CASE( funds_payments_limit )
       make_fund("TESTFUND", options, alice_id);
 
       auto fund_iter = db.get_index_type<fund_index>().indices().get<by_name>().find("TESTFUND");
-      const fund_object& fund = *fund_iter;
+      const fund_id_type fund_id = fund_iter->get_id();
 
       // disable autorenewal
       {
@@ -940,7 +941,7 @@ BOOST_AUTO_TEST_CASE( funds_payments_limit )
          fdo.fee = asset();
          fdo.from_account = bob_id;
          fdo.period = 10;
-         fdo.fund_id = fund.get_id();
+         fdo.fund_id = fund_id;
          set_expiration(db, trx);
          trx.operations.push_back(std::move(fdo));
          PUSH_TX(db, trx, ~0);
@@ -965,7 +966,7 @@ BOOST_AUTO_TEST_CASE( funds_payments_limit )
          fdo.fee = asset();
          fdo.from_account = bob_id;
          fdo.period = 10;
-         fdo.fund_id = fund.get_id();
+         fdo.fund_id = fund_id;
          set_expiration(db, trx);
          trx.operations.push_back(std::move(fdo));
          BOOST_REQUIRE_THROW(db.push_transaction(trx, ~0), fc::assert_exception);
@@ -986,7 +987,7 @@ BOOST_AUTO_TEST_CASE( funds_payments_limit )
          fdo.fee = asset();
          fdo.from_account = bob_id;
          fdo.period = 10;
-         fdo.fund_id = fund.get_id();
+         fdo.fund_id = fund_id;
          set_expiration(db, trx);
          trx.operations.push_back(std::move(fdo));
          PUSH_TX(db, trx, ~0);
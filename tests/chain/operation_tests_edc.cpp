@@ -175,24 +175,27 @@ BOOST_AUTO_TEST_CASE(change_asset_fee_test)
       create_edc(10000000000, asset(100, CORE_ASSET), asset(2, EDC_ASSET));
       create_test_asset();
 
-      const asset_object& edc_asset = *db.get_index_type<asset_index>().indices().get<by_symbol>().find(EDC_ASSET_SYMBOL);
-      const asset_object& test_asset = *db.get_index_type<asset_index>().indices().get<by_symbol>().find("TEST");
+      const asset_id_type test_asset_id = db.get_index_type<asset_index>().indices().get<by_symbol>().find("TEST")->get_id();
 
       // update test_asset's core_exchange_rate
       asset_update_exchange_rate_operation ex_upd_op;
-      ex_upd_op.asset_to_update = test_asset.get_id();
-      ex_upd_op.core_exchange_rate = price(asset(100, CORE_ASSET), asset(1, test_asset.get_id()));
+      ex_upd_op.asset_to_update = test_asset_id;
+      ex_upd_op.core_exchange_rate = price(asset(100, CORE_ASSET), asset(1, test_asset_id));
       trx.operations.push_back(ex_upd_op);
       trx.validate();
       db.push_transaction(trx, ~0);
       trx.clear();
 
       issue_uia(alice_id, asset(10000, EDC_ASSET));
-      issue_uia(alice_id, asset(10000, test_asset.get_id()));
+      issue_uia(alice_id, asset(10000, test_asset_id));
 
       generate_blocks(HARDFORK_623_TIME);
       generate_block();
 
+      // the assets were created in the pending state, generating the blocks has created them anew
+      const asset_object& edc_asset = EDC_ASSET(db);
+      const asset_object& test_asset = test_asset_id(db);
+
       enable_fees();
 
       db.modify(global_property_id_type()(db), [](global_property_object& gpo)
@@ -283,7 +286,6 @@ BOOST_AUTO_TEST_CASE(blind_transfer2_test)
       create_edc(10000000000, asset(100, CORE_ASSET), asset(2, EDC_ASSET));
       create_test_asset();
 
-      const asset_object& edc_asset = *db.get_index_type<asset_index>().indices().get<by_symbol>().find(EDC_ASSET_SYMBOL);
       const settings_object& b_settings = db.get(settings_id_type(0));
 
       issue_uia(alice_id, asset(10000, EDC_ASSET));
@@ -300,7 +302,8 @@ BOOST_AUTO_TEST_CASE(blind_transfer2_test)
 
       BOOST_CHECK(b_settings.blind_transfer_default_fee.amount == 1);
 
-      const asset_dynamic_data_object& asset_dyn_data = edc_asset.dynamic_asset_data_id(db);
+      // EDC was created in the pending state, generate_block() has created it anew
+      const asset_dynamic_data_object& asset_dyn_data = EDC_ASSET(db).dynamic_asset_data_id(db);
       BOOST_CHECK(asset_dyn_data.current_supply.value == 10000);
 
       // make blind_transfer2
@@ -496,4 +499,52 @@ BOOST_AUTO_TEST_CASE(operation_history_test)
    }
 }
 
+BOOST_AUTO_TEST_CASE(set_online_time_test)
+{
+   BOOST_TEST_MESSAGE( "=== set_online_time_test ===" );
+
+   try {
+
+      ACTOR(alice)
+      ACTOR(bob)
+      ACTOR(carol)
+
+      const auto& idx = db.get_index_type<account_online_index>().indices();
+      BOOST_CHECK(!db.has_online_info());
+
+      auto set_online_time = [&](const map<account_id_type, uint16_t>& online_info) {
+         set_online_time_operation op;
+         op.online_info = online_info;
+         trx.operations.push_back(op);
+         trx.validate();
+         db.push_transaction(trx, ~0);
+         trx.clear();
+      };
+
+      set_online_time({ { alice_id, 100 }, { bob_id, 200 } });
+      BOOST_CHECK(idx.size() == 2);
+      BOOST_CHECK(db.get_online_minutes(alice_id) == 100);
+      BOOST_CHECK(db.get_online_minutes(bob_id) == 200);
+      BOOST_CHECK(db.get_online_minutes(carol_id) == 0);
+      const account_online_id_type bob_online = idx.get<by_account>().find(bob_id)->id;
+
+      // each report replaces the previous one
+      set_online_time({ { bob_id, 200 }, { carol_id, 0 } });
+      BOOST_CHECK(idx.size() == 2);
+      BOOST_CHECK(db.get_online_minutes(alice_id) == 0);
+      BOOST_CHECK(idx.get<by_account>().find(bob_id)->id == bob_online);
+      BOOST_CHECK(db.get_online_minutes(bob_id) == 200);
+      BOOST_CHECK(idx.get<by_account>().count(carol_id) == 1);
+      BOOST_CHECK(db.has_online_info());
+
+      set_online_time({});
+      BOOST_CHECK(!db.has_online_info());
+   }
+   catch (fc::exception& e)
+   {
+      edump((e.to_detail_string()))
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -8,6 +8,7 @@
 
 #include <graphene/chain/account_object.hpp>
 #include <graphene/chain/asset_object.hpp>
+#include <graphene/chain/referral_index.hpp>
 #include <graphene/chain/tree.hpp>
 
 #include <fc/crypto/digest.hpp>
@@ -677,4 +678,102 @@ BOOST_AUTO_TEST_CASE( e_referrals_mandatory_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( referral_index_matches_tree_test )
+{
+   try {
+
+      BOOST_TEST_MESSAGE( "=== referral_index_matches_tree_test ===" );
+
+      std::vector<account_test_in> test_accounts = {
+            account_test_in("nathan", "committee-account", leaf_info(account_id_type(), 2000000)),
+            account_test_in("nathan1", "committee-account", leaf_info(account_id_type(), 300000)),
+      };
+
+      std::vector<account_children_in> test_accounts_children = {
+            account_children_in("nathan", 1, 5, 100000, "partner"),
+            account_children_in("nathan", 2, 25, 100000, "partner"),
+            account_children_in("nathan", 3, 30, 100000, "partner"),
+
+            account_children_in("nathan1", 1, 6, 150000, "partner1"),
+            account_children_in("nathan1", 2, 3, 40000, "partner1", false),
+            // partners below a re-parented account, counted with their mature balances
+            account_children_in("nathan1", 2, 2, 100000, "grandpartner1"),
+      };
+
+      db.modify(db.get_dynamic_global_properties(), [&](dynamic_global_property_object& dgpo) {
+         dgpo.next_maintenance_time = db.head_block_time() + fc::hours(24);
+      });
+      generate_blocks(db.head_block_time() + fc::hours(12));
+      set_expiration(db, this->trx);
+      CREATE_ACCOUNTS(test_accounts);
+
+      APPEND_CHILDREN(test_accounts_children);
+
+      auto compare = [&]() {
+         auto& acc_idx = db.get_index_type<account_index>();
+         auto& bal_idx = db.get_index_type<account_balance_index>();
+         auto& mat_bal_idx = db.get_index_type<account_mature_balance_index>();
+         referral_tree tree(acc_idx, bal_idx, asset_id_type(), account_id_type(), &mat_bal_idx);
+         tree.form();
+         std::list<referral_info> expected = tree.scan();
+         const referral_aggregate_index& index = db.get_referral_index(asset_id_type());
+         std::list<referral_info> actual = index.scan();
+
+         // the aggregates of every account, the root included, match those computed from scratch
+         referral_aggregate_index fresh;
+         fresh.rebuild(asset_id_type(), acc_idx, bal_idx, mat_bal_idx);
+         for (const auto& acc : acc_idx.indices())
+         {
+            const auto* e = fresh.find(acc.id);
+            const auto* a = index.find(acc.id);
+            BOOST_REQUIRE(e != nullptr && a != nullptr);
+            BOOST_CHECK(e->parent == a->parent);
+            BOOST_CHECK_EQUAL(e->level_1_partners, a->level_1_partners);
+            BOOST_CHECK_EQUAL(e->level_1_sum, a->level_1_sum);
+            BOOST_CHECK_EQUAL(e->level_2_partners, a->level_2_partners);
+            BOOST_CHECK_EQUAL(e->all_partners, a->all_partners);
+            BOOST_CHECK_EQUAL(e->all_sum, a->all_sum);
+         }
+
+         BOOST_REQUIRE_EQUAL(expected.size(), actual.size());
+         for (auto e = expected.begin(), a = actual.begin(); e != expected.end(); ++e, ++a)
+         {
+            BOOST_CHECK(e->to_account_id == a->to_account_id);
+            BOOST_CHECK_EQUAL(e->quantity, a->quantity);
+            BOOST_CHECK_EQUAL(e->rank, a->rank);
+            BOOST_REQUIRE_EQUAL(e->history.size(), a->history.size());
+            for (size_t i = 0; i < e->history.size(); ++i)
+            {
+               BOOST_CHECK(e->history[i].account_id == a->history[i].account_id);
+               BOOST_CHECK_EQUAL(e->history[i].balance, a->history[i].balance);
+               BOOST_CHECK_EQUAL(e->history[i].level, a->history[i].level);
+            }
+         }
+         return expected.size();
+      };
+
+      BOOST_CHECK(compare() >= 2);
+
+      // balances and referrers that change after the index was built
+      transfer(accounts_map["nathan"].id, accounts_map["nathan1"].id, asset(500000));
+      compare();
+
+      db.modify(accounts_map["nathan1"].get_id()(db), [&](account_object& a) {
+         a.referrer = accounts_map["nathan"].id;
+      });
+      compare();
+
+      db.modify(accounts_map["nathan1"].get_id()(db), [&](account_object& a) {
+         a.referrer = account_id_type();
+      });
+      compare();
+
+      accounts_map.clear();
+
+   } catch(fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
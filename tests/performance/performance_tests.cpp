@@ -30,6 +30,7 @@
 #include <graphene/chain/proposal_object.hpp>
 
 #include <graphene/db/simple_index.hpp>
+#include <graphene/protocol/signature_cache.hpp>
 
 #include <fc/crypto/digest.hpp>
 #include "../common/database_fixture.hpp"
@@ -51,6 +52,22 @@ BOOST_AUTO_TEST_CASE( sigcheck_benchmark )
    auto elapsed = end-start;
    wdump( ((100000.0*1000000.0) / elapsed.count()) );
 }
+
+BOOST_AUTO_TEST_CASE( cached_sigcheck_benchmark )
+{
+   BOOST_TEST_MESSAGE( "=== cached_sigcheck_benchmark ===" );
+   fc::ecc::private_key nathan_key = fc::ecc::private_key::generate();
+   auto digest = fc::sha256::hash("hello");
+   auto sig = nathan_key.sign_compact( digest );
+   graphene::protocol::signature_cache cache;
+   auto start = fc::time_point::now();
+   for( uint32_t i = 0; i < 100000; ++i )
+      auto pub = cache.recover( sig, digest );
+   auto end = fc::time_point::now();
+   auto elapsed = end-start;
+   BOOST_CHECK( cache.recover( sig, digest ) == nathan_key.get_public_key() );
+   wdump( ((100000.0*1000000.0) / elapsed.count())(cache.hits())(cache.misses()) );
+}
 /*
 BOOST_AUTO_TEST_CASE( transfer_benchmark )
 {